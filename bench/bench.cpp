@@ -0,0 +1,461 @@
+#include <new>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+
+#include "common.hpp"
+#include "net.hpp"
+#include "request.hpp"
+#include "engine.hpp"
+
+// Microbenchmarks of mrk's own hot paths, reported as ns/op and allocations/op
+//
+//   mrk_bench [filter]
+//
+// Only benchmarks whose name contains filter are run.
+
+uint64_t allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    allocations++;
+
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#define BENCH_MIN_TIME_MS   200
+
+volatile uint64_t sink;
+
+struct benchmark
+{
+    std::string name;
+    std::function<void(uint64_t)> run;
+};
+
+const std::string response =
+    "HTTP/1.1 200 OK\r\n"
+    "Server: bench\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 13\r\n"
+    "\r\n"
+    "Hello, World!";
+
+std::string largeResponse(size_t body)
+{
+    return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body) + "\r\n\r\n" + std::string(body, 'x');
+}
+
+std::string chunkedResponse(size_t chunk, size_t count)
+{
+    std::string data = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+    char size[32];
+    snprintf(size, sizeof(size), "%zx\r\n", chunk);
+
+    for (size_t i = 0; i < count; ++i)
+        data += size + std::string(chunk, 'x') + "\r\n";
+
+    return data + "0\r\n\r\n";
+}
+
+#ifndef _WIN32
+// A worker with one keep-alive connection over a socketpair, the bench answering as the server
+struct loopFixture
+{
+    std::unique_ptr<threadData> thread = std::make_unique<threadData>();
+    int fd = -1;
+    int server = -1;
+};
+
+bool loopOpen(loopFixture& f, const config& cfg)
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+        return false;
+    fcntl(sv[1], F_SETFL, fcntl(sv[1], F_GETFL, 0) | O_NONBLOCK);
+
+    std::unique_ptr<threadData>& thread = f.thread;
+    thread->cfg = cfg;
+    thread->targets.resize(1);
+    thread->latency = std::make_unique<stats>();
+    statsInit(thread->latency, cfg.timeout * 1000);
+    timingInit(thread->timing, cfg.timeout * 1000);
+    thread->statuses.resize(HTTP_STATUS_MAX);
+    thread->scratch.resize(RECV_SCRATCH);
+
+    if (cfg.kernelTime)
+    {
+        for (auto& kind : thread->stamped)
+        {
+            kind = std::make_unique<stats>();
+            statsInit(kind, cfg.timeout * 1000);
+        }
+        sockStamping(sv[1]);
+    }
+
+    if (!pollInit(thread->poll))
+        return false;
+
+    thread->now = clockNow_us();
+    timerInit(thread->timers, thread->now / 1000);
+
+    std::unique_ptr<connection> conn = std::make_unique<connection>();
+    conn->request = makeRequest(thread->cfg, thread->cfg.url);
+    conn->check.rules = &thread->cfg.validate;
+    validateReset(conn->check);
+    conn->fd = sv[1];
+    conn->target = &thread->targets[0];
+    conn->timer.data = conn.get();
+    conn->phase = WRITE;
+
+    pollAdd(thread->poll, sv[1]);
+    thread->conns.insert({ sv[1], std::move(conn) });
+
+    f.fd = sv[1];
+    f.server = sv[0];
+
+    return true;
+}
+
+void loopClose(loopFixture& f)
+{
+    f.thread->conns.clear();
+    pollClose(f.thread->poll);
+    close(f.server);
+}
+
+// Takes the request in flight and answers it, false once the connection is gone
+bool loopAnswer(loopFixture& f, char* scratch)
+{
+    if (read(f.server, scratch, RECV_SCRATCH) <= 0)
+        return false;
+
+    return write(f.server, response.data(), response.size()) > 0;
+}
+
+// One round as threadMain runs it on a readable edge: the batch timestamp, then the event that
+// reads the answer, records it and writes the next request
+template <typename Sock>
+bool loopRound(loopFixture& f, char* scratch)
+{
+    auto it = f.thread->conns.find(f.fd);
+    if (it == f.thread->conns.end())
+        return false;
+
+    f.thread->now = clockNow_us();
+    socketEvent<Sock, Protocol::HTTP>(f.thread, it->second);
+
+    return loopAnswer(f, scratch);
+}
+
+template <typename Sock>
+void loopRounds(const config& cfg, uint64_t n)
+{
+    loopFixture f;
+    std::vector<char> scratch(RECV_SCRATCH);
+
+    // The first request goes out before the rounds are counted
+    if (loopOpen(f, cfg) && loopRound<Sock>(f, scratch.data()))
+    {
+        for (uint64_t i = 0; i < n; ++i)
+            if (!loopRound<Sock>(f, scratch.data()))
+                break;
+    }
+
+    sink += f.thread->complete;
+    loopClose(f);
+}
+#endif
+
+// Feeds data to the parser in pieces of at most step bytes
+uint64_t parseResponse(httpResponse& r, const std::string& data, size_t step)
+{
+    responseReset(r);
+
+    for (size_t i = 0; i < data.size(); i += step)
+        responseParse(r, data.data() + i, std::min(step, data.size() - i));
+
+    return r.status + r.body;
+}
+
+void fillStats(std::unique_ptr<stats>& statis, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; ++i)
+        stats_record(statis, 50 + (i * 7919) % 5000);
+}
+
+void runBenchmark(const benchmark& b)
+{
+    // Calibrate until one batch takes long enough to time reliably
+    uint64_t iterations = 1;
+    long long elapsed = 0;
+
+    while (true)
+    {
+        auto start = timeNow();
+        b.run(iterations);
+        elapsed = getTime_us(start);
+
+        if (elapsed >= 10000 || iterations >= (1ULL << 40))
+            break;
+
+        iterations *= elapsed < 1000 ? 10 : 2;
+    }
+
+    iterations = std::max<uint64_t>(1, iterations * (BENCH_MIN_TIME_MS * 1000) / std::max<long long>(elapsed, 1));
+
+    uint64_t allocs = allocations;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    b.run(iterations);
+
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    allocs = allocations - allocs;
+
+    printf("  %-28s%12.2f%12.2f%14llu\n", b.name.c_str(), ns / (double)iterations, allocs / (double)iterations, (unsigned long long)iterations);
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter = argc > 1 ? argv[1] : "";
+
+    std::string large = largeResponse(64 * 1024);
+    std::string chunked = chunkedResponse(4096, 16);
+    httpResponse parsed;
+
+    validation rules;
+    rules.substring = "</html>";
+    rules.hash = true;
+    rules.reference = xxh64(large.data(), large.size());
+    validationState check;
+    check.rules = &rules;
+    validateReset(check);
+
+    std::unique_ptr<stats> latency = std::make_unique<stats>();
+    std::unique_ptr<stats> merged = std::make_unique<stats>();
+    statsInit(latency, SOCKET_TIMEOUT_MS * 1000);
+    statsInit(merged, SOCKET_TIMEOUT_MS * 1000);
+    fillStats(latency, 100000);
+
+    const unsigned char mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+    std::string message(16, 'x');
+    std::string frames;
+    for (int i = 0; i < 64; ++i)
+        frames += wsFrame(WS_OP_TEXT, message.data(), message.size(), mask);
+    wsParser frameParser;
+
+    std::string resp, lines;
+    for (int i = 0; i < 64; ++i)
+    {
+        resp += "*2\r\n$5\r\nhello\r\n:42\r\n";
+        lines += "VALUE key 0 5\r\n";
+    }
+    messageFraming respFraming, lineFraming;
+    scanFraming("resp", respFraming);
+    scanFraming("delim:\\r\\n", lineFraming);
+    messageParser replies;
+
+    scenario flow;
+    std::string flowError;
+    std::istringstream flowFile("step login\nPOST /login\nbody {\"user\":\"bench\"}\nextract token json data.session.token\n"
+        "step profile\nGET /users/${token}/profile\nheader Authorization: Bearer ${token}\n");
+    scenarioParse(flowFile, flow, flowError);
+    flow.host = "localhost:8080";
+    session visit;
+    sessionInit(visit, flow);
+    visit.values[0] = "0123456789abcdef0123456789abcdef";
+    std::string rendered;
+    std::string document = "{\"data\":{\"items\":[1,2,3,{\"a\":[4,5]}],\"session\":{\"user\":7,\"token\":\"0123456789abcdef\"}}}";
+    std::vector<jsonKey> tokenPath = { { "data", 0 }, { "session", 0 }, { "token", 0 } };
+
+    config cfg;
+    cfg.url = parseURL("http://localhost:8080/index.html");
+
+    timerWheel wheel;
+    timerInit(wheel, 0);
+    timerNode node;
+
+    clockInit(true);
+
+    config stampedCfg = cfg;
+    stampedCfg.kernelTime = true;
+
+    std::vector<benchmark> benchmarks =
+    {
+        { "clock/now", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += clockNow_ns();
+        } },
+        { "clock/monotonic", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += monotonicNow_ns();
+        } },
+        { "clock/chrono", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        } },
+        { "parse/response", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += parseResponse(parsed, response, response.size());
+        } },
+        { "parse/response-split", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += parseResponse(parsed, response, 7);
+        } },
+        { "parse/content-length-64k", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += parseResponse(parsed, large, RECV_SCRATCH);
+        } },
+        { "parse/chunked-64k", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += parseResponse(parsed, chunked, RECV_SCRATCH);
+        } },
+        { "validate/xxh64-64k", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += xxh64(large.data(), large.size());
+        } },
+        { "validate/substring-64k", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += findSubstring(large.data(), large.size(), rules.substring) != nullptr;
+        } },
+        { "validate/response-64k", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                responseReset(parsed);
+                responseParse(parsed, large.data(), large.size(), validateSpan, &check);
+                sink += validateEnd(check, parsed);
+            }
+        } },
+        { "ws/frame-build", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += wsFrame(WS_OP_TEXT, message.data(), message.size(), mask).size();
+        } },
+        { "ws/parse-frames-64", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                uint64_t messages = 0;
+                bool closed = false;
+                wsReset(frameParser);
+                sink += wsParse(frameParser, frames.data(), frames.size(), messages, closed) + messages;
+            }
+        } },
+        { "tcp/resp-64", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                uint64_t messages = 0, errors = 0;
+                messageReset(replies);
+                sink += messageParse(replies, respFraming, resp.data(), resp.size(), messages, errors) + messages;
+            }
+        } },
+        { "tcp/delim-64", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                uint64_t messages = 0, errors = 0;
+                messageReset(replies);
+                sink += messageParse(replies, lineFraming, lines.data(), lines.size(), messages, errors) + messages;
+            }
+        } },
+        { "scenario/request", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                visit.step = i & 1;
+                sessionRequest(flow, visit, rendered);
+                sink += rendered.size();
+            }
+        } },
+        { "scenario/json-lookup", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                const char* value = nullptr;
+                size_t size = 0;
+                sink += jsonLookup(document.data(), document.size(), tokenPath, value, size) + size;
+            }
+        } },
+        { "stats/record", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += stats_record(latency, 50 + (i & 1023));
+        } },
+        { "stats/merge", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                stats_merge(merged, latency);
+        } },
+        { "stats/percentile", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += stats_percentile(latency, 99.0);
+        } },
+        { "request/render", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                sink += makeRequest(cfg, cfg.url).size();
+        } },
+        { "timer/arm-cancel", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                timerArm(wheel, node, i & 4095);
+                timerCancel(wheel, node);
+            }
+        } },
+#ifndef _WIN32
+        { "cycle/socketpair", [&](uint64_t n) {
+            int sv[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+                return;
+            fcntl(sv[1], F_SETFL, fcntl(sv[1], F_GETFL, 0) | O_NONBLOCK);
+
+            std::unique_ptr<connection> conn = std::make_unique<connection>();
+            conn->fd = sv[1];
+            std::vector<char> scratch(RECV_SCRATCH);
+
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                uint64_t start = clockNow_us();
+                if (write(sv[0], response.data(), response.size()) < 0)
+                    break;
+
+                size_t bytes = 0;
+                if (sockRead(conn, scratch.data(), scratch.size(), bytes) != OK)
+                    break;
+
+                responseParse(conn->response, scratch.data(), bytes);
+                if (responseDone(conn->response) && conn->response.status > 0)
+                    stats_record(latency, clockNow_us() - start);
+
+                responseReset(conn->response);
+            }
+
+            close(sv[0]);
+        } },
+        { "loop/round-plain", [&](uint64_t n) {
+            loopRounds<plainSocket>(cfg, n);
+        } },
+#ifdef __linux__
+        { "loop/round-stamped", [&](uint64_t n) {
+            loopRounds<stampedSocket>(stampedCfg, n);
+        } },
+#endif
+#endif
+    };
+
+    printf("mrk_bench %s, clock %s\n", VERSION.c_str(), clockName().c_str());
+    printf("  %-28s%12s%12s%14s\n", "Benchmark", "ns/op", "allocs/op", "iterations");
+
+    for (const auto& b : benchmarks)
+    {
+        if (filter.empty() || b.name.find(filter) != std::string::npos)
+            runBenchmark(b);
+    }
+
+    return 0;
+}
@@ -0,0 +1,320 @@
+#include "baseline.hpp"
+#include "units.hpp"
+
+#include <fstream>
+#include <random>
+
+#define METRICS 6
+
+const char* metricNames[METRICS] = { "rps", "mean", "p50", "p90", "p99", "p99.9" };
+const long double metricPercentiles[METRICS] = { 0, 0, 50.0L, 90.0L, 99.0L, 99.9L };
+
+// Closes one interval of the run being recorded, length_ms may be short for the last one
+void baselineAdd(baseline& b, std::unique_ptr<stats>& latency, uint64_t length_ms)
+{
+    intervalSample sample{ length_ms, latency->count, latency->sum, latency->min, latency->max, {} };
+
+    if (latency->count)
+    {
+        for (size_t i = stats_bucket(latency->min); i <= stats_bucket(latency->max); ++i)
+            if (latency->data[i])
+                sample.buckets.push_back({ static_cast<uint32_t>(i), latency->data[i] });
+    }
+
+    b.intervals.push_back(std::move(sample));
+}
+
+bool baselineSave(const std::string& path, const baseline& b)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "#mrk baseline v1: latency in us, not corrected for coordinated omission\n");
+    fprintf(file, "url %s\n", b.url.c_str());
+    fprintf(file, "connections %llu\n", (unsigned long long)b.connections);
+    fprintf(file, "threads %llu\n", (unsigned long long)b.threads);
+    fprintf(file, "limit_us %llu\n", (unsigned long long)b.limit_us);
+    fprintf(file, "sub_bits %d\n", STATS_SUB_BITS);
+    fprintf(file, "#interval length_ms,count,sum,min,max,buckets as index delta:count\n");
+
+    for (const intervalSample& sample : b.intervals)
+    {
+        fprintf(file, "interval %llu,%llu,%llu,%llu,%llu,", (unsigned long long)sample.length_ms, (unsigned long long)sample.count,
+            (unsigned long long)sample.sum, (unsigned long long)(sample.count ? sample.min : 0), (unsigned long long)sample.max);
+
+        uint32_t last = 0;
+        const char* separator = "";
+
+        for (const auto& bucket : sample.buckets)
+        {
+            fprintf(file, "%s%u:%llu", separator, bucket.first - last, (unsigned long long)bucket.second);
+            last = bucket.first;
+            separator = " ";
+        }
+
+        fprintf(file, "\n");
+    }
+
+    return fclose(file) == 0;
+}
+
+bool intervalParse(const std::string& text, intervalSample& sample)
+{
+    unsigned long long length, count, sum, min, max;
+    int used = 0;
+
+    if (sscanf(text.c_str(), "%llu,%llu,%llu,%llu,%llu,%n", &length, &count, &sum, &min, &max, &used) != 5 || !used)
+        return false;
+
+    sample = { length, count, sum, count ? min : UINT64_MAX, max, {} };
+
+    std::stringstream buckets(text.substr(used));
+    std::string pair;
+    uint64_t index = 0, total = 0;
+
+    while (buckets >> pair)
+    {
+        unsigned long delta;
+        unsigned long long n;
+
+        if (sscanf(pair.c_str(), "%lu:%llu", &delta, &n) != 2)
+            return false;
+
+        index += delta;
+        total += n;
+        sample.buckets.push_back({ static_cast<uint32_t>(index), n });
+    }
+
+    return total == count && length;
+}
+
+bool baselineLoad(const std::string& path, baseline& b, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "cannot read " + path;
+        return false;
+    }
+
+    std::string line;
+    int number = 0;
+
+    while (std::getline(file, line))
+    {
+        number++;
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t space = line.find(' ');
+        std::string key = line.substr(0, space);
+        std::string value = space == std::string::npos ? "" : line.substr(space + 1);
+
+        if (key == "url")
+            b.url = value;
+        else if (key == "connections")
+            b.connections = strtoull(value.c_str(), nullptr, 10);
+        else if (key == "threads")
+            b.threads = strtoull(value.c_str(), nullptr, 10);
+        else if (key == "limit_us")
+            b.limit_us = strtoull(value.c_str(), nullptr, 10);
+        else if (key == "sub_bits" && value != std::to_string(STATS_SUB_BITS))
+        {
+            error = "histograms of " + value + " sub-bucket bits, this build uses " + std::to_string(STATS_SUB_BITS);
+            return false;
+        }
+        else if (key == "interval")
+        {
+            intervalSample sample;
+            if (!intervalParse(value, sample))
+            {
+                error = "line " + std::to_string(number) + ": bad interval";
+                return false;
+            }
+
+            b.intervals.push_back(std::move(sample));
+        }
+    }
+
+    if (b.intervals.empty() || !b.limit_us)
+    {
+        error = "no intervals in " + path;
+        return false;
+    }
+
+    return true;
+}
+
+// rps=5,p99=10: metric=percent, metrics are rps, mean, p50, p90, p99 and p99.9
+int scanThresholds(std::string s, std::vector<threshold>& thresholds)
+{
+    std::stringstream items(s);
+    std::string item;
+
+    while (std::getline(items, item, ','))
+    {
+        size_t equals = item.find('=');
+        if (equals == std::string::npos)
+            return 1;
+
+        threshold t;
+        t.metric = item.substr(0, equals);
+
+        if (std::find(std::begin(metricNames), std::end(metricNames), t.metric) == std::end(metricNames))
+            return 1;
+
+        char* end = nullptr;
+        t.pct = strtold(item.c_str() + equals + 1, &end);
+        if (end == item.c_str() + equals + 1 || (*end && strcmp(end, "%") != 0) || t.pct < 0)
+            return 1;
+
+        thresholds.push_back(t);
+    }
+
+    return thresholds.empty();
+}
+
+// Every metric of the intervals picked, as if they had been one run
+void measure(const baseline& b, const std::vector<size_t>& pick, std::unique_ptr<stats>& merged, long double* out)
+{
+    stats_reset(merged);
+    uint64_t length = 0;
+
+    for (size_t i : pick)
+    {
+        const intervalSample& sample = b.intervals[i];
+        length += sample.length_ms;
+
+        if (!sample.count)
+            continue;
+
+        for (const auto& bucket : sample.buckets)
+            if (bucket.first < merged->data.size())
+                merged->data[bucket.first] += bucket.second;
+
+        merged->count += sample.count;
+        merged->sum += sample.sum;
+        merged->min = std::min(merged->min, sample.min);
+        merged->max = std::max(merged->max, sample.max);
+    }
+
+    out[0] = length ? merged->count * 1000.0L / length : 0;
+    out[1] = stats_mean(merged);
+
+    for (int m = 2; m < METRICS; ++m)
+        out[m] = static_cast<long double>(stats_percentile(merged, metricPercentiles[m]));
+}
+
+long double relative(long double before, long double after)
+{
+    return before > 0 ? (after - before) * 100.0L / before : 0;
+}
+
+// Point changes from the whole runs, intervals from resampling the intervals of both with replacement
+std::vector<comparison> baselineCompare(const baseline& before, const baseline& after, const std::vector<threshold>& thresholds)
+{
+    std::unique_ptr<stats> merged = std::make_unique<stats>();
+    statsInit(merged, std::max(before.limit_us, after.limit_us));
+
+    std::vector<size_t> all[2], pick[2];
+    const baseline* runs[2] = { &before, &after };
+    long double point[2][METRICS];
+
+    uint64_t work = 0;
+    for (int r = 0; r < 2; ++r)
+    {
+        for (size_t i = 0; i < runs[r]->intervals.size(); ++i)
+        {
+            all[r].push_back(i);
+            work += runs[r]->intervals[i].buckets.size() + 1;
+        }
+
+        measure(*runs[r], all[r], merged, point[r]);
+        pick[r].resize(all[r].size());
+    }
+
+    uint64_t resamples = std::max<uint64_t>(BOOTSTRAP_MIN, std::min<uint64_t>(BOOTSTRAP_RESAMPLES, BOOTSTRAP_WORK / std::max<uint64_t>(work, 1)));
+
+    // Fixed seed, the same two files always give the same intervals
+    std::mt19937_64 random(0x6d726b);
+    std::vector<long double> changes[METRICS];
+
+    for (uint64_t n = 0; n < resamples; ++n)
+    {
+        long double values[2][METRICS];
+
+        for (int r = 0; r < 2; ++r)
+        {
+            std::uniform_int_distribution<size_t> index(0, all[r].size() - 1);
+            for (size_t& i : pick[r])
+                i = index(random);
+
+            measure(*runs[r], pick[r], merged, values[r]);
+        }
+
+        for (int m = 0; m < METRICS; ++m)
+            changes[m].push_back(relative(values[0][m], values[1][m]));
+    }
+
+    std::vector<comparison> result;
+
+    for (int m = 0; m < METRICS; ++m)
+    {
+        std::sort(changes[m].begin(), changes[m].end());
+
+        comparison c;
+        c.metric = metricNames[m];
+        c.before = point[0][m];
+        c.after = point[1][m];
+        c.change = relative(c.before, c.after);
+        c.low = changes[m][static_cast<size_t>(0.025 * (resamples - 1))];
+        c.high = changes[m][static_cast<size_t>(0.975 * (resamples - 1))];
+
+        for (const threshold& t : thresholds)
+            if (t.metric == c.metric)
+                c.threshold = t.pct;
+
+        // Worse by more than the threshold, and the interval leaves no room for no change at all
+        bool higherBetter = m == 0;
+        long double worse = higherBetter ? -c.change : c.change;
+        bool significant = higherBetter ? c.high < 0 : c.low > 0;
+
+        c.regressed = c.threshold >= 0 && worse > c.threshold && significant;
+
+        result.push_back(c);
+    }
+
+    return result;
+}
+
+// Returns whether any metric regressed beyond its threshold
+bool comparePrint(const std::vector<comparison>& result, const std::string& path)
+{
+    bool regressed = false;
+
+    printf("  Compared with %s, 95%% bootstrap confidence intervals\n", path.c_str());
+    printf("  Metric%12s%12s%10s%22s%8s\n", "Baseline", "Current", "Change", "95% CI", "Limit");
+
+    for (const comparison& c : result)
+    {
+        bool rate = c.metric == "rps";
+        std::string before = rate ? formatMetric(c.before) : formatTime_us(c.before);
+        std::string after = rate ? formatMetric(c.after) : formatTime_us(c.after);
+
+        char interval[48];
+        snprintf(interval, sizeof(interval), "[%+.2Lf%%, %+.2Lf%%]", c.low, c.high);
+
+        char limit[16] = "";
+        if (c.threshold >= 0)
+            snprintf(limit, sizeof(limit), "%.1Lf%%", c.threshold);
+
+        printf("  %-6s%12s%12s%+9.2Lf%%%22s%8s  %s\n", rate ? "Req/s" : c.metric.c_str(), before.c_str(), after.c_str(), c.change,
+            interval, limit, c.regressed ? "REGRESSED" : (c.threshold >= 0 ? "ok" : ""));
+
+        regressed |= c.regressed;
+    }
+
+    return regressed;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "stats.hpp"
+
+// Resamples drawn for each confidence interval, fewer on very long runs to bound the work
+#define BOOTSTRAP_RESAMPLES     1000
+#define BOOTSTRAP_MIN           200
+#define BOOTSTRAP_WORK          200000000ULL
+
+// Thresholds used by --compare when --threshold is not given, in percent
+#define COMPARE_THRESHOLDS      "rps=5,p99=10"
+
+// Exit status of a comparison that found a regression beyond a threshold
+#define EXIT_REGRESSION         2
+
+// Latency histogram of one timeline interval, only the buckets that were used
+struct intervalSample
+{
+    uint64_t length_ms;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    std::vector<std::pair<uint32_t, uint64_t>> buckets;
+};
+
+// What --save writes and --compare reads: the run's intervals, the whole run histogram is their sum
+struct baseline
+{
+    std::string url;
+    uint64_t connections = 0;
+    uint64_t threads = 0;
+    uint64_t limit_us = 0;
+    std::vector<intervalSample> intervals;
+};
+
+// Largest tolerated change of a metric for the worse, in percent
+struct threshold
+{
+    std::string metric;
+    long double pct;
+};
+
+// One metric of two runs, the interval is the 95% bootstrap interval of the relative change
+struct comparison
+{
+    std::string metric;
+    long double before;
+    long double after;
+    long double change;
+    long double low;
+    long double high;
+    long double threshold = -1;
+    bool regressed = false;
+};
+
+void baselineAdd(baseline&, std::unique_ptr<stats>&, uint64_t);
+bool baselineSave(const std::string&, const baseline&);
+bool baselineLoad(const std::string&, baseline&, std::string&);
+
+int scanThresholds(std::string, std::vector<threshold>&);
+
+std::vector<comparison> baselineCompare(const baseline&, const baseline&, const std::vector<threshold>&);
+bool comparePrint(const std::vector<comparison>&, const std::string&);
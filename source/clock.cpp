@@ -0,0 +1,116 @@
+#include "clock.hpp"
+
+#include <thread>
+#include <sstream>
+
+#if defined(__GNUC__) && defined(CLOCK_HAS_TSC)
+#include <cpuid.h>
+#endif
+
+clockInfo clk;
+
+// CPUID 0x80000007 EDX bit 8: TSC runs at a constant rate in every P/C-state
+bool tscInvariant()
+{
+#if defined(CLOCK_HAS_TSC) && defined(__GNUC__)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+        return false;
+
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx >> 8) & 1;
+#elif defined(CLOCK_HAS_TSC) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0x80000000);
+    if (static_cast<unsigned int>(regs[0]) < 0x80000007)
+        return false;
+
+    __cpuid(regs, 0x80000007);
+    return (regs[3] >> 8) & 1;
+#else
+    return false;
+#endif
+}
+
+#ifdef CLOCK_HAS_TSC
+// Reads TSC and CLOCK_MONOTONIC as close together as possible
+void tscSample(uint64_t& tsc, uint64_t& ns)
+{
+    uint64_t best = UINT64_MAX;
+
+    for (int i = 0; i < 5; ++i)
+    {
+        uint64_t before = monotonicNow_ns();
+        uint64_t t = __rdtsc();
+        uint64_t after = monotonicNow_ns();
+
+        if (after - before < best)
+        {
+            best = after - before;
+            tsc = t;
+            ns = before + (after - before) / 2;
+        }
+    }
+}
+#endif
+
+double clockOverhead()
+{
+    const int reads = 100000;
+    uint64_t sum = 0;
+
+    uint64_t start = monotonicNow_ns();
+    for (int i = 0; i < reads; ++i)
+        sum += clockNow_ns();
+    uint64_t elapsed = monotonicNow_ns() - start;
+
+    // Keep the loop from being optimized away
+    volatile uint64_t sink = sum;
+    (void)sink;
+
+    return elapsed / static_cast<double>(reads);
+}
+
+// Picks the timestamp source: invariant TSC calibrated against CLOCK_MONOTONIC when allowed and
+// available, clock_gettime otherwise. The calibration takes CLOCK_CALIBRATION_MS.
+void clockInit(bool tsc)
+{
+    clk = {};
+
+#ifdef CLOCK_HAS_TSC
+    if (tsc && tscInvariant())
+    {
+        uint64_t tsc0 = 0, ns0 = 0, tsc1 = 0, ns1 = 0;
+
+        tscSample(tsc0, ns0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(CLOCK_CALIBRATION_MS));
+        tscSample(tsc1, ns1);
+
+        double ns_per_tick = (ns1 - ns0) / static_cast<double>(tsc1 - tsc0);
+
+        // Anything outside 100MHz - 10GHz means the TSC can't be trusted
+        if (tsc1 > tsc0 && ns_per_tick > 0.1 && ns_per_tick < 10.0)
+        {
+            clk.source = ClockSource::TSC;
+            clk.base = tsc1;
+            clk.offset_ns = ns1;
+            clk.ns_per_tick = ns_per_tick;
+        }
+    }
+#endif
+
+    clk.overhead_ns = clockOverhead();
+}
+
+std::string clockName()
+{
+    std::stringstream name;
+    name.precision(2);
+
+    if (clk.source == ClockSource::TSC)
+        name << "tsc @ " << std::fixed << 1.0 / clk.ns_per_tick << "GHz";
+    else
+        name << "monotonic";
+
+    return name.str();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CLOCK_HAS_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define CLOCK_HAS_TSC
+#endif
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+#define CLOCK_CALIBRATION_MS  20
+
+enum class ClockSource
+{
+    MONOTONIC,
+    TSC
+};
+
+// Process wide timestamp source, set up once by clockInit before workers start
+struct clockInfo
+{
+    ClockSource source = ClockSource::MONOTONIC;
+    uint64_t base = 0;          // TSC value at calibration
+    uint64_t offset_ns = 0;     // CLOCK_MONOTONIC at calibration
+    double ns_per_tick = 0.0;
+    double overhead_ns = 0.0;   // measured cost of one clockNow_ns
+};
+
+extern clockInfo clk;
+
+void clockInit(bool);
+std::string clockName();
+
+inline uint64_t monotonicNow_ns()
+{
+#ifdef _WIN32
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// Wall clock, only to compare with timestamps taken on other machines
+inline uint64_t realtimeNow_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t clockNow_ns()
+{
+#ifdef CLOCK_HAS_TSC
+    // Signed: a core whose TSC reads a little behind the calibrating one lands just before the
+    // base, not 2^64 ticks after it
+    if (clk.source == ClockSource::TSC)
+        return clk.offset_ns + static_cast<int64_t>(static_cast<int64_t>(__rdtsc() - clk.base) * clk.ns_per_tick);
+#endif
+    return monotonicNow_ns();
+}
+
+inline uint64_t clockNow_us()
+{
+    return clockNow_ns() / 1000;
+}
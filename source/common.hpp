@@ -25,6 +25,7 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/time.h>
@@ -33,6 +34,9 @@
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #endif 
 
@@ -44,11 +48,26 @@
 #include <chrono>
 #include <atomic>
 #include <unordered_map>
+#include <mutex>
 
 #include "parser.hpp"
+#include "validate.hpp"
+#include "websocket.hpp"
+#include "framing.hpp"
+#include "scenario.hpp"
 
 #include "units.hpp"
 #include "stats.hpp"
+#include "timer.hpp"
+#include "clock.hpp"
+#include "poll.hpp"
+#include "timeline.hpp"
+#include "search.hpp"
+#include "baseline.hpp"
+#include "replay.hpp"
+#include "sse.hpp"
+#include "perf.hpp"
+#include "think.hpp"
 
 const std::string VERSION = "pre-release 0.0.3";
 
@@ -65,9 +84,34 @@ typedef int socket_t;
 
 #define RECVBUF  8192
 
+// Responses are parsed straight out of one per-thread buffer of this size, whatever their length
+#define RECV_SCRATCH  (64 * 1024)
+
+// Most body bytes dropped per syscall with --discard
+#define DISCARD_MAX   (16 * 1024 * 1024)
+
+// Bodies up to this size go out with the header in one gathered write, larger ones through sendfile
+#define SENDFILE_MIN  (64 * 1024)
+
 #define MAX_THREAD_RATE_S   10000000
 #define SOCKET_TIMEOUT_MS   2000
 #define RECORD_INTERVAL_MS  100
+#define CLIENT_BOUND_PCT    95.0
+
+// Status codes listed on their own in the report, next to the classes
+#define STATUS_TOP          5
+#define SIZE_LIMIT          (1ULL << 40)
+
+// State machine steps run for one readiness event before yielding to other connections
+#define SOCKET_EVENT_STEPS  8
+
+// Busy poll noise floor histogram: 10ns buckets up to 1ms
+#define NOISE_RESOLUTION_NS 10
+#define NOISE_LIMIT_NS      1000000
+
+#if defined(__linux__) && !defined(SO_PREFER_BUSY_POLL)
+# define SO_PREFER_BUSY_POLL 69
+#endif
 
 enum phases
 {
@@ -76,27 +120,134 @@ enum phases
     READ    
 };
 
+// What the URL schema puts on the wire
+enum class Protocol
+{
+    HTTP,
+    WEBSOCKET,      // ws://, HTTP upgrade then frames
+    TCP             // tcp://, raw payload and --framing replies
+};
+
+// Request body shared read-only by every connection, memory-mapped once from --body-file
+struct requestBody
+{
+    ~requestBody()
+    {
+#ifndef _WIN32
+        if (fd != -1 && data && size)
+            munmap(const_cast<char*>(data), size);
+        if (fd != -1)
+            close(fd);
+#endif
+    }
+
+    const char* data = nullptr;
+    size_t size = 0;
+    int fd = -1;
+    std::vector<char> buffer;
+};
+
+// One URL of the run, resolved once by engineInit: connections never look the host up again
+struct endpoint
+{
+    std::string name;               // as given, for the report
+    ParsedURL url;
+    uint64_t weight = 1;            // --weights, share of the connections
+    sockaddr_storage addr = {};
+    socklen_t addrlen = 0;
+};
+
 struct config
 {
     uint64_t connections = 10;
     uint64_t duration = 10;
     uint64_t threads = 1;
     uint64_t timeout = SOCKET_TIMEOUT_MS;
-    uint64_t pipeline = 0;
+    uint64_t pipeline = 1;          // requests, or messages, sent per round
     bool     delay = false;
     bool     dynamic = false;
     bool     latency = false;
+    bool     clientStats = false;
+    bool     tsc = true;
+    bool     busyPoll = false;
+    bool     discard = false;
+    uint64_t busyPollUs = 0;
+    std::vector<int> cpus;
+    uint64_t interval = 1000;       // ms per timeline interval
+    std::string intervalLog;
+    bool     heatmap = false;
+    Protocol protocol = Protocol::HTTP;
+    uint64_t wsSize = 16;
+    std::string payload;            // tcp:// request bytes from --payload
+    messageFraming framing;
+    std::shared_ptr<requestBody> round;     // one round of prebuilt messages, ws:// and tcp://
+    std::string method;
+    std::string host;               // Host header override
+    std::string bodyFile;
+    std::shared_ptr<requestBody> body;
+    std::string scenarioFile;
+    std::shared_ptr<scenario> plan;         // compiled --scenario, shared read-only
+    validation validate;
+    sloTarget search;
+    uint64_t step = 5;              // s per --search step
+    std::string saveFile;
+    std::string compareFile;
+    std::vector<threshold> thresholds;      // --threshold, COMPARE_THRESHOLDS when not given
+    std::string replayFile;
+    long double speedup = 1;
+    uint64_t replayStart = 0;       // us on the clockNow_us scale the log's first request is due
+    bool     capped = false;        // -d given, a replay otherwise runs to the end of the log
+    bool     stream = false;        // --stream: one held open response per connection, timed per event
+    bool     stamped = false;
+    eventTime eventStamp;           // --event-time
+    uint64_t users = 0;             // --users, connections that are virtual users
+    thinkTime think;                // pause of a user between an answer and its next request
+    bool     perfCounters = false;  // --perf-counters: a perf_event_open group per worker
+    bool     kernelTime = false;    // --kernel-time: SO_TIMESTAMPING on every socket
+    bool     sampling = false;      // workers hand their latency over every tick, for engineCollect
 
-    ParsedURL url;
+    ParsedURL url;                  // of the first target, what Host and the requests are built from
+    std::vector<endpoint> targets;  // every URL of the run, just url when left empty
 
     //char* script;
     //SSL_CTX* ctx;
 };
 
+// Latency and body size of the responses carrying one status code
+struct statusStats
+{
+    std::unique_ptr<stats> latency;
+    std::unique_ptr<stats> size;
+};
+
 struct statistics
 {
     std::unique_ptr<stats> latency = std::make_unique<stats>();
     std::unique_ptr<stats> requests = std::make_unique<stats>();
+    timingStats timing;
+    std::vector<statusStats> statuses = std::vector<statusStats>(HTTP_STATUS_MAX);
+    std::vector<statusStats> steps;
+    std::unique_ptr<stats> delivery = std::make_unique<stats>();
+    std::unique_ptr<stats> stamped[STAMPS];
+};
+
+// What the connections of one target measured, the run's totals are the sum over its targets
+struct endpointStats
+{
+    uint64_t connections = 0;           // opened at the start, replacements keep their target
+    uint64_t complete = 0;
+    uint64_t bytes = 0;
+    errorsData errors = {};
+    std::unique_ptr<stats> latency;     // only when the run has several targets
+};
+
+// What happened to the streams of --stream
+struct streamCounters
+{
+    uint64_t opened;            // answered with a 2xx header
+    uint64_t ended;             // finished or closed by the server, opened again
+    uint64_t unstamped;         // events without the --event-time field
+    uint64_t ahead;             // stamped later than they arrived: the clocks disagree
 };
 
 struct buffer
@@ -130,29 +281,87 @@ struct connection
     //SSL* ssl;
     phases phase = CONNECT;
     bool delayed = false;
-    std::chrono::high_resolution_clock::time_point start;
+    bool parked = false;            // kept open, idle while the search runs fewer connections
+    bool thinking = false;          // --think: a user pausing, waits for its timer and not the socket
+    size_t endpoint = 0;            // index of its target, for the whole life of the connection
+    endpointStats* target = nullptr;
+    uint64_t thought = 0;           // since when
+    uint64_t scheduled = 0;         // --replay: when the request taken from the log was due
+    timerNode timer;
+    uint64_t start = 0;
+    uint64_t opened = 0;            // socket created, the connect phase counts from here
+    uint64_t sent = 0;              // last byte of the round written
+    uint64_t firstByte = 0;         // first byte of the answer read
+    uint64_t kernelSent = 0;        // --kernel-time, us of CLOCK_REALTIME: last transmit timestamp of the round
+    uint64_t kernelRead = 0;        // receive timestamp of the last segment read
     std::string request = "";
+    const requestBody* payload = nullptr;
     size_t length = 0;
     size_t written = 0;
     uint64_t pending = 0;
     buffer headers;
     buffer body;
-    std::vector<char> data;
-    size_t headersize = 0;
+    uint64_t received = 0;          // bytes read in this round
+    bool truncate = true;           // --discard: the socket takes MSG_TRUNC, until it refuses it
+    bool upgraded = false;
+    httpResponse response;
+    validationState check;
+    wsParser frames;
+    messageParser replies;
+    sseParser events;
+    session flow;
 };
 
 struct threadData
 {
     config cfg;
+    const std::atomic<bool>* running;   // of the run
     uint64_t connections;
     uint64_t complete;
     uint64_t requests;
     uint64_t bytes;
     uint64_t sent;
-    std::chrono::high_resolution_clock::time_point start;
-    errorsData errors;
-    fd_set fds;
-    std::vector<int> fd;
+    uint64_t body;
+    uint64_t now;
+    uint64_t interval;
+    std::unique_ptr<stats> latency;
+    std::unique_ptr<stats> rate;        // Req/Sec samples
+    std::vector<statusStats> statuses;
+    std::vector<statusStats> steps;     // per scenario step
+    std::vector<uint64_t> misses;       // extractions that found nothing, per step
+    std::unique_ptr<stats> delivery;    // --event-time: sent by the server to read here
+    streamCounters stream;
+    int64_t epoch_us;                   // wall clock minus clockNow_us, for --event-time
+    std::unique_ptr<stats> window;          // latency since the last sampling tick
+    std::unique_ptr<stats> windowShared;    // handed over to the timeline under windowLock
+    timingStats timing;
+    timingStats timingWindow;
+    timingStats timingShared;
+    std::mutex windowLock;
+    std::vector<endpointStats> targets;     // same order as cfg.targets, errors are counted there
+    std::vector<size_t> opening;        // target of every connection opened at the start
+    validationErrors mismatch;
+    clientStats client;
+    perfGroup perf;
+    std::mt19937_64 random;             // think times
+    uint64_t thought_us;                // time users spent thinking, for how many did on average
+    std::unique_ptr<stats> noise;
+    uint64_t noiseMax;
+    bool busyPollDenied;
+    std::unique_ptr<stats> stamped[STAMPS];
+    uint64_t unstamped;                 // answers without both kernel timestamps
+    bool kernelTimeDenied;
+    std::vector<int> ready;
+    std::vector<int> pending;
     std::unordered_map<int, std::unique_ptr<connection>> conns;
-    socket_t max = 0;
+    std::vector<size_t> reconnects;     // targets of the connections to open again
+    std::atomic<uint64_t> target{ UINT64_MAX };     // connections to keep busy, set by --search
+    std::vector<int> parked;
+    uint64_t parkedCount;
+    replayCursor replay;
+    std::atomic<bool> drained{ false };     // --replay: log done and every connection idle
+    poller poll;
+    timerWheel timers;
+    std::vector<timerNode*> expired;
+    std::vector<char> scratch;
 };
\ No newline at end of file
@@ -0,0 +1,1710 @@
+#include "engine.hpp"
+
+// Checks the configuration and prepares what the workers share: files, prebuilt rounds, the scenario
+bool engineInit(engine& load, const config& settings, std::string& error)
+{
+    config& cfg = load.cfg;
+    cfg = settings;
+
+    // A single URL is a run of one target
+    if (cfg.targets.empty())
+        cfg.targets.push_back({ "", cfg.url });
+
+    cfg.url = cfg.targets.front().url;
+    cfg.protocol = cfg.url.schema == "ws" ? Protocol::WEBSOCKET : cfg.url.schema == "tcp" ? Protocol::TCP : Protocol::HTTP;
+
+    for (endpoint& target : cfg.targets)
+    {
+        const ParsedURL& url = target.url;
+
+        if (target.name.empty())
+            target.name = url.socket.empty() ? url.schema + "://" + url.host + ":" + url.port + url.uri : "unix:" + url.socket + ":" + url.uri;
+
+        // One event loop serves them all, it is built for one protocol
+        if (url.schema != cfg.url.schema)
+        {
+            error = "Every target of a run needs the same schema, " + cfg.targets.front().name + " and " + target.name + " differ";
+            return false;
+        }
+
+        if (!target.weight)
+        {
+            error = "Target weights are 1 or more";
+            return false;
+        }
+    }
+
+    if (cfg.url.schema == "https")
+    {
+        // TO DO
+        error = "https:// is not supported yet";
+        return false;
+    }
+
+    for (const endpoint& target : cfg.targets)
+    {
+        if (cfg.protocol == Protocol::TCP && target.url.port.empty() && target.url.socket.empty())
+        {
+            error = "tcp:// targets need a port, e.g. tcp://localhost:6379";
+            return false;
+        }
+    }
+
+    bool several = cfg.targets.size() > 1;
+
+    // Sessions and the log carry one Host, they are not split between targets
+    if (several && (!cfg.scenarioFile.empty() || !cfg.replayFile.empty()))
+    {
+        error = "--scenario and --replay run against a single target";
+        return false;
+    }
+
+    // Every target gets a connection of its own at least, each worker opens connections / threads
+    std::vector<size_t> opening = engineDeal(cfg, cfg.connections / std::max<uint64_t>(cfg.threads, 1) * cfg.threads);
+    for (size_t i = 0; i < cfg.targets.size(); ++i)
+    {
+        if (std::find(opening.begin(), opening.end(), i) == opening.end())
+        {
+            error = "No connection left for " + cfg.targets[i].name + ", give more connections or a higher weight";
+            return false;
+        }
+    }
+
+    if (!cfg.bodyFile.empty())
+    {
+        cfg.body = std::make_shared<requestBody>();
+        if (!bodyLoad(cfg.bodyFile, *cfg.body))
+        {
+            error = "Cannot read body file " + cfg.bodyFile;
+            return false;
+        }
+    }
+
+    if (!cfg.validate.hashFile.empty())
+    {
+        requestBody expected;
+        if (!bodyLoad(cfg.validate.hashFile, expected))
+        {
+            error = "Cannot read expected body " + cfg.validate.hashFile;
+            return false;
+        }
+
+        cfg.validate.reference = xxh64(expected.data, expected.size);
+    }
+
+    if (cfg.pipeline > 1 && cfg.body && cfg.protocol == Protocol::HTTP)
+    {
+        error = "--pipeline sends requests back to back, it cannot be combined with --body-file";
+        return false;
+    }
+
+    if (!cfg.scenarioFile.empty())
+    {
+        std::string reason;
+        cfg.plan = std::make_shared<scenario>();
+
+        if (!scenarioLoad(cfg.scenarioFile, *cfg.plan, reason))
+        {
+            error = "Scenario " + cfg.scenarioFile + ": " + reason;
+            return false;
+        }
+
+        cfg.plan->host = hostHeader(cfg, cfg.url);
+
+        // Every step needs the answer to the previous one
+        if (cfg.pipeline > 1 || cfg.body || cfg.protocol != Protocol::HTTP || (cfg.discard && cfg.plan->capture))
+        {
+            error = "--scenario runs one HTTP request at a time, its bodies come from the file: no --pipeline, --body-file,\n"
+                "ws:// or tcp://, and no --discard when a step extracts from json";
+            return false;
+        }
+    }
+
+    if (!cfg.replayFile.empty())
+    {
+        // Every round is one request of the log, sent when it is due
+        if (cfg.plan || cfg.body || cfg.pipeline > 1 || cfg.protocol != Protocol::HTTP || !cfg.search.rules.empty())
+        {
+            error = "--replay sends the requests of the log one at a time: no --scenario, --body-file, --pipeline,\n"
+                "--search, ws:// or tcp://";
+            return false;
+        }
+
+        replayCursor check;
+        std::string reason;
+        if (!replayOpen(check, cfg.replayFile, reason))
+        {
+            error = "Replay " + reason;
+            return false;
+        }
+
+        if (!cfg.capped)
+            cfg.duration = REPLAY_UNCAPPED_S;
+    }
+
+    if (cfg.stream)
+    {
+        // A stream never completes, the connection is held by one response
+        if (cfg.plan || cfg.body || cfg.pipeline > 1 || cfg.discard || cfg.protocol != Protocol::HTTP || !cfg.search.rules.empty() ||
+            !cfg.replayFile.empty() || cfg.validate.status || cfg.validate.length || validateBody(cfg.validate))
+        {
+            error = "--stream holds one response open per connection: no --scenario, --body-file, --pipeline, --discard,\n"
+                "--expect-*, --search, --replay, ws:// or tcp://";
+            return false;
+        }
+    }
+    else if (cfg.stamped)
+    {
+        error = "--event-time reads the events of --stream";
+        return false;
+    }
+
+    // Users decide when to send, the search and the log cannot
+    if (cfg.think.kind != ThinkKind::NONE && (!cfg.search.rules.empty() || !cfg.replayFile.empty() || cfg.stream))
+    {
+        error = "--think paces every user on its own: no --search, --replay or --stream";
+        return false;
+    }
+
+    if (cfg.kernelTime)
+    {
+#ifndef __linux__
+        error = "--kernel-time needs SO_TIMESTAMPING, Linux only";
+        return false;
+#endif
+        // Answers are timed from a request to its last byte
+        if (cfg.stream || cfg.discard)
+        {
+            error = "--kernel-time needs the data read with recvmsg: no --discard or --stream";
+            return false;
+        }
+    }
+
+    if (cfg.protocol != Protocol::HTTP && (cfg.discard || cfg.validate.status || cfg.validate.length || validateBody(cfg.validate)))
+    {
+        error = "--discard and --expect-* apply to HTTP responses only";
+        return false;
+    }
+
+    // Rounds of messages are built once and shared by every connection, like a body file
+    std::string message;
+
+    if (cfg.protocol == Protocol::TCP)
+    {
+        message = cfg.body ? std::string(cfg.body->data, cfg.body->size) : cfg.payload;
+        if (message.empty())
+        {
+            error = "tcp:// needs a request, from --payload or --body-file";
+            return false;
+        }
+    }
+
+    if (cfg.protocol == Protocol::WEBSOCKET)
+    {
+        // Messages are masked once with a random key and resent as they are
+        std::random_device random;
+        unsigned char mask[4];
+        for (unsigned char& m : mask)
+            m = static_cast<unsigned char>(random());
+
+        std::string generated(cfg.wsSize, 'x');
+        std::string frame = cfg.body ? wsFrame(WS_OP_BINARY, cfg.body->data, cfg.body->size, mask)
+            : wsFrame(WS_OP_TEXT, generated.data(), generated.size(), mask);
+
+        message = frame;
+    }
+
+    if (cfg.protocol != Protocol::HTTP)
+    {
+        cfg.round = std::make_shared<requestBody>();
+        for (uint64_t i = 0; i < cfg.pipeline; ++i)
+            cfg.round->buffer.insert(cfg.round->buffer.end(), message.begin(), message.end());
+
+        cfg.round->data = cfg.round->buffer.data();
+        cfg.round->size = cfg.round->buffer.size();
+    }
+
+    if (cfg.discard && validateBody(cfg.validate))
+    {
+        error = "--discard drops the body, it cannot be combined with --expect-substring or --expect-hash";
+        return false;
+    }
+
+    // Connections never look a host up, they reuse these addresses
+    for (endpoint& target : cfg.targets)
+    {
+        if (!sockResolve(target, error))
+            return false;
+    }
+
+#ifndef _WIN32
+    // A server closing mid-request must show up as a write error, not kill the process
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+
+    // Timestamps are process wide, the first run picks their source
+    static std::once_flag clockOnce;
+    std::call_once(clockOnce, [&] { clockInit(cfg.tsc); });
+
+    statistics& statis = load.result.statis;
+    statsInit(statis.latency, cfg.timeout * 1000);
+    statsInit(statis.requests, MAX_THREAD_RATE_S);
+    timingInit(statis.timing, cfg.timeout * 1000);
+    statsInit(statis.delivery, cfg.timeout * 1000);
+
+    for (auto& kind : statis.stamped)
+    {
+        kind = std::make_unique<stats>();
+        statsInit(kind, cfg.timeout * 1000);
+    }
+
+    load.result.targets.resize(cfg.targets.size());
+
+    if (several)
+    {
+        for (endpointStats& target : load.result.targets)
+        {
+            target.latency = std::make_unique<stats>();
+            statsInit(target.latency, cfg.timeout * 1000);
+        }
+    }
+
+    return true;
+}
+
+// Opens the connections and lets the workers go, engineStop ends the run
+void engineStart(engine& load)
+{
+    config& cfg = load.cfg;
+
+    if (!cfg.replayFile.empty())
+        cfg.replayStart = clockNow_us() + REPLAY_LEAD_MS * 1000;
+
+    threadEntry loop = engineLoop(cfg);
+
+    uint64_t share = cfg.connections / cfg.threads;
+    std::vector<size_t> opening = engineDeal(cfg, share * cfg.threads);
+
+    load.running.store(true);
+    load.threadsData.resize(cfg.threads);
+    load.threads.reserve(cfg.threads);
+
+    for (uint64_t i = 0; i < cfg.threads; ++i) 
+    {
+        std::unique_ptr<threadData> data = std::make_unique<threadData>();
+        data->cfg = cfg;
+        data->running = &load.running;
+        data->connections = share;
+
+        // A slice of the interleaved order, every worker gets its mix of the targets
+        data->opening.assign(opening.begin() + i * share, opening.begin() + (i + 1) * share);
+        data->targets.resize(cfg.targets.size());
+
+        if (cfg.targets.size() > 1)
+        {
+            for (endpointStats& target : data->targets)
+            {
+                target.latency = std::make_unique<stats>();
+                statsInit(target.latency, cfg.timeout * 1000);
+            }
+        }
+
+        // Histograms are per thread and merged after the run, nothing is shared while it goes
+        data->latency = std::make_unique<stats>();
+        data->rate = std::make_unique<stats>();
+        statsInit(data->latency, cfg.timeout * 1000);
+        statsInit(data->rate, MAX_THREAD_RATE_S);
+        timingInit(data->timing, cfg.timeout * 1000);
+        data->statuses.resize(HTTP_STATUS_MAX);
+
+        if (cfg.plan)
+        {
+            data->steps.resize(cfg.plan->steps.size());
+            data->misses.resize(cfg.plan->steps.size());
+
+            for (statusStats& step : data->steps)
+                statusInit(step, cfg.timeout);
+        }
+
+        if (cfg.kernelTime)
+        {
+            for (auto& kind : data->stamped)
+            {
+                kind = std::make_unique<stats>();
+                statsInit(kind, cfg.timeout * 1000);
+            }
+        }
+
+        if (cfg.stamped)
+        {
+            data->delivery = std::make_unique<stats>();
+            statsInit(data->delivery, cfg.timeout * 1000);
+        }
+
+        if (cfg.sampling)
+        {
+            data->window = std::make_unique<stats>();
+            data->windowShared = std::make_unique<stats>();
+            statsInit(data->window, cfg.timeout * 1000);
+            statsInit(data->windowShared, cfg.timeout * 1000);
+            timingInit(data->timingWindow, cfg.timeout * 1000);
+            timingInit(data->timingShared, cfg.timeout * 1000);
+        }
+
+        if (cfg.busyPoll)
+        {
+            data->noise = std::make_unique<stats>();
+            statsInit(data->noise, NOISE_LIMIT_NS / NOISE_RESOLUTION_NS);
+        }
+        
+        load.threadsData.at(i) = std::move(data);
+        
+        load.threads.emplace_back(std::thread(loop, i + 1, std::ref(load.threadsData.at(i))));
+    }
+
+    load.start = timeNow();
+}
+
+// Ends the run and merges what every worker measured into load.result
+void engineStop(engine& load)
+{
+    if (!load.running.exchange(false))
+        return;
+
+    results& result = load.result;
+    statistics& statis = result.statis;
+    result.runtime_us = getTime_us(load.start);
+
+    // Workers publish their client stats on exit
+    for (auto& t : load.threads)
+        if (t.joinable())
+            t.join();
+
+    for (auto& t : load.threadsData)
+    {
+        result.complete += t->complete;
+        result.bytes += t->bytes;
+        result.sent += t->sent;
+        result.body += t->body;
+
+        for (size_t i = 0; i < t->targets.size(); ++i)
+        {
+            endpointStats& from = t->targets[i];
+            endpointStats& into = result.targets[i];
+
+            into.connections += from.connections;
+            into.complete += from.complete;
+            into.bytes += from.bytes;
+            errorsMerge(into.errors, from.errors);
+            errorsMerge(result.errors, from.errors);
+
+            if (from.latency)
+                stats_merge(into.latency, from.latency);
+        }
+
+        stats_merge(statis.latency, t->latency);
+        stats_merge(statis.requests, t->rate);
+        timingMerge(statis.timing, t->timing);
+
+        if (t->delivery)
+            stats_merge(statis.delivery, t->delivery);
+
+        for (int kind = 0; kind < STAMPS; ++kind)
+            if (t->stamped[kind])
+                stats_merge(statis.stamped[kind], t->stamped[kind]);
+
+        result.thought_us += t->thought_us;
+        result.unstamped += t->unstamped;
+        result.kernelTimeDenied |= t->kernelTimeDenied;
+
+        result.stream.opened += t->stream.opened;
+        result.stream.ended += t->stream.ended;
+        result.stream.unstamped += t->stream.unstamped;
+        result.stream.ahead += t->stream.ahead;
+
+        for (int code = 0; code < HTTP_STATUS_MAX; ++code)
+        {
+            if (!t->statuses[code].latency)
+                continue;
+
+            statusInit(statis.statuses[code], load.cfg.timeout);
+            stats_merge(statis.statuses[code].latency, t->statuses[code].latency);
+            stats_merge(statis.statuses[code].size, t->statuses[code].size);
+        }
+
+        for (size_t step = 0; step < t->steps.size(); ++step)
+        {
+            if (statis.steps.size() <= step)
+                statusInit(statis.steps.emplace_back(), load.cfg.timeout);
+
+            stats_merge(statis.steps[step].latency, t->steps[step].latency);
+            stats_merge(statis.steps[step].size, t->steps[step].size);
+            result.misses.resize(t->steps.size());
+            result.misses[step] += t->misses[step];
+        }
+
+        result.mismatch.status += t->mismatch.status;
+        result.mismatch.length += t->mismatch.length;
+        result.mismatch.substring += t->mismatch.substring;
+        result.mismatch.hash += t->mismatch.hash;
+    }
+}
+
+// Spreads a number of busy connections over the workers, the others stay open and idle
+void engineTarget(engine& load, uint64_t concurrency)
+{
+    size_t n = load.threadsData.size();
+
+    for (size_t i = 0; i < n; ++i)
+        load.threadsData[i]->target.store(concurrency / n + (i < concurrency % n ? 1 : 0));
+}
+
+// Order in which count connections are dealt to the targets: smooth weighted round robin, so any
+// run of it, like a worker's slice, holds the targets close to their weights
+std::vector<size_t> engineDeal(const config& cfg, uint64_t count)
+{
+    size_t n = cfg.targets.size();
+    std::vector<int64_t> current(n, 0);
+    int64_t total = 0;
+
+    for (const endpoint& target : cfg.targets)
+        total += static_cast<int64_t>(target.weight);
+
+    std::vector<size_t> order;
+    order.reserve(count);
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        size_t best = 0;
+
+        for (size_t t = 0; t < n; ++t)
+        {
+            current[t] += static_cast<int64_t>(cfg.targets[t].weight);
+            if (current[t] > current[best])
+                best = t;
+        }
+
+        current[best] -= total;
+        order.push_back(best);
+    }
+
+    return order;
+}
+
+// Whether every worker is done with its part of the --replay log
+bool engineDrained(engine& load)
+{
+    for (auto& t : load.threadsData)
+        if (!t->drained.load())
+            return false;
+
+    return !load.threadsData.empty();
+}
+
+// The event loop built for this run's socket calls and protocol, the other features stay runtime
+// flags: they cost a predictable branch where they apply
+template <typename Sock>
+threadEntry protocolLoop(Protocol protocol)
+{
+    switch (protocol)
+    {
+    case Protocol::WEBSOCKET:
+        return &threadMain<Sock, Protocol::WEBSOCKET>;
+    case Protocol::TCP:
+        return &threadMain<Sock, Protocol::TCP>;
+    default:
+        return &threadMain<Sock, Protocol::HTTP>;
+    }
+}
+
+threadEntry engineLoop(const config& cfg)
+{
+#ifdef __linux__
+    if (cfg.kernelTime)
+        return protocolLoop<stampedSocket>(cfg.protocol);
+#endif
+
+    return protocolLoop<plainSocket>(cfg.protocol);
+}
+
+template <typename Sock, Protocol P>
+void threadMain(uint64_t id, std::unique_ptr<threadData>& thread)
+{
+    if (!thread->cfg.cpus.empty())
+        threadPin(thread->cfg.cpus[(id - 1) % thread->cfg.cpus.size()]);
+
+    if (!pollInit(thread->poll))
+        return;
+
+    thread->scratch.resize(RECV_SCRATCH);
+    thread->random.seed(std::random_device()() + id);
+
+    bool replaying = !thread->cfg.replayFile.empty();
+    if (replaying)
+    {
+        // Thread N takes every Nth line, all of them count from the same first request
+        std::string error;
+        replayCursor& replay = thread->replay;
+        replay.thread = id - 1;
+        replay.threads = thread->cfg.threads;
+        replay.start_us = thread->cfg.replayStart;
+        replay.speedup = thread->cfg.speedup;
+        replay.host = hostHeader(thread->cfg, thread->cfg.url);
+
+        if (!replayOpen(replay, thread->cfg.replayFile, error))
+        {
+            thread->drained.store(true);
+            return;
+        }
+    }
+
+    thread->now = clockNow_us();
+    timerInit(thread->timers, thread->now / 1000);
+
+    if (thread->cfg.stamped)
+        thread->epoch_us = static_cast<int64_t>(realtimeNow_us()) - static_cast<int64_t>(clockNow_us());
+
+    for (size_t endpoint : thread->opening)
+    {
+        thread->targets[endpoint].connections++;
+        socketConnect<Sock, P>(thread, endpoint);
+    }
+
+    thread->interval = thread->now;
+
+    uint64_t begin = thread->now;
+    uint64_t last_ns = clockNow_ns();
+
+    // Counts the loop only, not the setup above
+    if (thread->cfg.perfCounters && perfOpen(thread->perf))
+        perfStart(thread->perf);
+    bool idle = false;
+
+    while (thread->running->load(std::memory_order_relaxed))
+    {
+        uint64_t wait = 0;
+
+        // Busy polling never sleeps, neither do connections cut short in the previous batch
+        if (!thread->cfg.busyPoll && thread->pending.empty())
+        {
+            uint64_t record = thread->interval + RECORD_INTERVAL_MS * 1000;
+            wait = record > thread->now ? record - thread->now : 0;
+
+            uint64_t next = timerNext(thread->timers);
+            if (next != TIMER_NONE && next * 1000 < wait)
+                wait = next * 1000;
+
+            // Up in time for the next request of the log, when a connection is free to send it
+            const replayEntry* due = replaying && !thread->parked.empty() ? replayPeek(thread->replay) : nullptr;
+            if (due)
+                wait = std::min<uint64_t>(wait, due->due > thread->now ? due->due - thread->now : 0);
+        }
+
+        uint64_t waiting = clockNow_us();
+
+        thread->ready.clear();
+        thread->ready.swap(thread->pending);
+    
+        int ready_fds = pollWait(thread->poll, wait, thread->ready);
+        if (ready_fds == -1)             
+            break;
+
+        // One timestamp for every event of this batch
+        uint64_t now_ns = clockNow_ns();
+        thread->now = now_ns / 1000;
+
+        client.wait_us += thread->now - waiting;
+        client.iterations++;
+        client.syscalls++;
+
+        if (!thread->ready.empty())
+        {
+            client.wakeups++;
+            client.events += thread->ready.size();
+            idle = false;
+        }
+        else if (thread->cfg.busyPoll)
+        {
+            // Back to back empty polls: the gap is the client's own noise
+            if (idle)
+                noiseRecord(thread, now_ns - last_ns);
+
+            idle = true;
+        }
+
+        last_ns = now_ns;
+
+        for (int fd : thread->ready)
+        {            
+            auto it = thread->conns.find(fd);
+            if (it == thread->conns.end())
+                continue;
+
+            socketEvent<Sock, P>(thread, it->second);
+        }
+
+        thread->expired.clear();
+        timerAdvance(thread->timers, thread->now / 1000, thread->expired);
+
+        for (timerNode* node : thread->expired)
+        {
+            connection* expired = static_cast<connection*>(node->data);
+
+            if (expired->thinking)
+                socketWake(thread, thread->conns[expired->fd]);
+            else
+                socketTimeout(thread, thread->conns[expired->fd]);
+        }
+
+        for (size_t endpoint : thread->reconnects)
+            socketConnect<Sock, P>(thread, endpoint);
+        thread->reconnects.clear();
+
+        if (!thread->parked.empty())
+            socketUnpark(thread);
+
+        if (replaying && thread->parkedCount == thread->conns.size() && thread->reconnects.empty() && replayEnded(thread->replay))
+            thread->drained.store(true);
+        
+        uint64_t elapsed_us = thread->now - thread->interval;
+        if (elapsed_us >= RECORD_INTERVAL_MS * 1000)
+        {
+            uint64_t requests = (thread->requests / (double)elapsed_us) * 1000000;
+
+            stats_record(thread->rate, requests);
+
+            thread->requests = 0;
+            thread->interval = thread->now;
+
+            if (thread->window)
+                windowFlush(thread);
+        }        
+    }
+
+    perfStop(thread->perf);
+
+    if (thread->window)
+        windowFlush(thread);
+
+    // Users still thinking at the end
+    for (auto& it : thread->conns)
+        if (it.second->thinking)
+            thread->thought_us += thread->now - std::min(it.second->thought, thread->now);
+
+    client.wall_us = clockNow_us() - begin;
+    client.cpu_us = threadCpu_us();
+    thread->client = client;
+
+    thread->conns.clear();
+    pollClose(thread->poll);
+}
+
+// Hands the latency of the last sampling tick to the timeline, the lock is taken once per tick
+void windowFlush(std::unique_ptr<threadData>& thread)
+{
+    {
+        std::lock_guard<std::mutex> lock(thread->windowLock);
+        stats_merge(thread->windowShared, thread->window);
+        timingMerge(thread->timingShared, thread->timingWindow);
+    }
+
+    stats_reset(thread->window);
+    timingReset(thread->timingWindow);
+}
+
+// Takes what every worker handed over since the last call, the phases too when asked
+void engineCollect(engine& load, std::unique_ptr<stats>& into, timingStats* timing)
+{
+    for (auto& t : load.threadsData)
+    {
+        std::lock_guard<std::mutex> lock(t->windowLock);
+        stats_merge(into, t->windowShared);
+        stats_reset(t->windowShared);
+
+        if (timing)
+            timingMerge(*timing, t->timingShared);
+
+        timingReset(t->timingShared);
+    }
+}
+
+void threadPin(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), 1ULL << cpu);
+#endif
+}
+
+void noiseRecord(std::unique_ptr<threadData>& thread, uint64_t gap_ns)
+{
+    uint64_t n = gap_ns / NOISE_RESOLUTION_NS;
+
+    if (gap_ns > thread->noiseMax)
+        thread->noiseMax = gap_ns;
+
+    stats_record(thread->noise, std::min<uint64_t>(n, thread->noise->limit - 1));
+}
+
+// Opens a connection to the target at index endpoint of cfg.targets, it stays with that target
+template <typename Sock, Protocol P>
+int socketConnect(std::unique_ptr<threadData>& thread, size_t endpoint) 
+{
+#ifdef _WIN32
+    WSADATA wsaData;
+
+    int wsaResult = WSAStartup(MAKEWORD(2, 0), &wsaData);
+    if (wsaResult != 0)
+    {
+        printf("WSAStartup failed with error: %d\n", wsaResult);
+        return 0;
+    }
+#endif
+        
+    const auto& target = thread->cfg.targets[endpoint];
+    bool local = !target.url.socket.empty();
+
+#ifdef _WIN32
+    if (local)
+    {
+        printf("unix: targets are not supported on Windows\n");
+        return 0;
+    }
+#endif
+
+    int fd, flags;
+    if ((fd = local ? socket(AF_UNIX, SOCK_STREAM, 0) : socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
+    {
+        printf("Cannot create socket\n");
+        return 0;
+    }
+    
+#ifdef _WIN32    
+    u_long mode = 1;
+    if (ioctlsocket(fd, FIONBIO, &mode) != 0)
+#else
+    flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+#endif
+    {
+        printf("Problems with not-blocking\n");
+        Sock::close(fd);
+        return 0;
+    }
+
+    // socket, fcntl x2, connect, setsockopt; the address was resolved by engineInit
+    client.syscalls += local ? 4 : 5;
+
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&target.addr), target.addrlen) < 0)
+    {        
+#ifdef _WIN32
+        if (WSAGetLastError() != WSAEWOULDBLOCK) 
+#else
+        if (errno != EINPROGRESS)
+#endif
+        {
+            errorsData& errors = thread->targets[endpoint].errors;
+            socketError(errors.connect, errors);
+            Sock::close(fd);
+            
+            return -1;
+        }
+    }
+
+    flags = 1;
+#ifdef _WIN32
+    char enable = flags ? 1 : 0;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+#else
+    if (!local)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flags, sizeof(flags));
+#endif
+
+#ifdef __linux__
+    if (thread->cfg.busyPollUs)
+    {
+        // Let the kernel spin on the device queue instead of waiting for an interrupt
+        int us = static_cast<int>(thread->cfg.busyPollUs);
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) == -1 ||
+            setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &flags, sizeof(flags)) == -1)
+            thread->busyPollDenied = true;
+    }
+
+    if (thread->cfg.kernelTime)
+    {
+        client.syscalls++;
+        if (!sockStamping(fd))
+            thread->kernelTimeDenied = true;
+    }
+#endif
+        
+    std::unique_ptr<connection> conn = std::make_unique<connection>();
+    if (P == Protocol::WEBSOCKET)
+    {
+        conn->request = wsHandshake(hostHeader(thread->cfg, target.url), target.url.uri);
+        conn->response.upgrade = true;
+    }
+    else if (P == Protocol::TCP)
+    {
+        conn->payload = thread->cfg.round.get();
+    }
+    else if (thread->cfg.plan)
+    {
+        // Every connection is a session, its requests are rendered step by step
+        sessionInit(conn->flow, *thread->cfg.plan);
+    }
+    else if (!thread->cfg.replayFile.empty())
+    {
+        // Requests come from the log, rendered when one is due
+    }
+    else
+    {
+        // Pipelined requests go out back to back in one write
+        std::string request = makeRequest(thread->cfg, target.url);
+        for (uint64_t i = 0; i < thread->cfg.pipeline; ++i)
+            conn->request += request;
+
+        conn->payload = thread->cfg.body.get();
+    }
+
+    conn->response.head = thread->cfg.method == "HEAD";
+    conn->check.rules = &thread->cfg.validate;
+    validateReset(conn->check);
+    conn->fd = fd;
+    conn->endpoint = endpoint;
+    conn->target = &thread->targets[endpoint];
+    conn->opened = thread->now;
+    conn->timer.data = conn.get();
+
+    // Connect deadline
+    timerArm(thread->timers, conn->timer, thread->now / 1000 + thread->cfg.timeout);
+
+    pollAdd(thread->poll, fd);
+    thread->conns.insert({ fd, std::move(conn) });
+        
+    return fd;
+}
+
+void socketReconnect(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{   
+    int fd = conn->fd;
+
+    timerCancel(thread->timers, conn->timer);
+    pollRemove(thread->poll, fd);
+
+    if (conn->parked)
+        thread->parkedCount--;
+
+    // New connections are opened once the current batch of events is done, to the same target
+    thread->reconnects.push_back(conn->endpoint);
+    
+    // Closes the socket, conn is dangling from here on
+    thread->conns.erase(fd);
+}
+
+void socketTimeout(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    conn->target->errors.timeout++;
+    socketReconnect(thread, conn);
+}
+
+// Drives the connection until it has to wait for the socket again
+template <typename Sock, Protocol P>
+void socketEvent(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    // Whatever the socket says waits for the end of the pause, a close shows up on the next request
+    if (conn->thinking)
+        return;
+
+    for (int step = 0; step < SOCKET_EVENT_STEPS; ++step)
+    {
+        bool more = false;
+
+        if (conn->phase == CONNECT)
+            more = socketCheck<Sock, P>(thread, conn);
+        else if (conn->phase == WRITE)
+            more = socketWrite<Sock, P>(thread, conn);
+        else if (conn->phase == READ)
+            more = socketRead<Sock, P>(thread, conn);
+
+        if (!more)
+            return;
+    }
+
+    // Out of budget, no new edge will come so resume it on the next iteration
+    thread->pending.push_back(conn->fd);
+}
+
+void socketPark(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    if (conn->parked)
+        return;
+
+    conn->parked = true;
+    thread->parked.push_back(conn->fd);
+    thread->parkedCount++;
+
+    // Idle is not late: the connect deadline would still be armed. A close by the server is noticed on the next round
+    timerCancel(thread->timers, conn->timer);
+    pollWatch(thread->poll, conn->fd, false);
+}
+
+// Pauses a user for pause_us, from the answer it just got: the connection is left to the timer
+// wheel, so mostly idle users cost a timer each and no wakeups
+void socketThink(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, uint64_t pause_us)
+{
+    conn->thinking = true;
+    conn->thought = thread->now;
+    conn->phase = WRITE;
+
+    pollWatch(thread->poll, conn->fd, false);
+    timerArm(thread->timers, conn->timer, (thread->now + pause_us) / 1000);
+}
+
+void socketWake(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    conn->thinking = false;
+    thread->thought_us += thread->now - std::min(conn->thought, thread->now);
+
+    socketPhase(thread, conn, WRITE);
+    thread->pending.push_back(conn->fd);
+}
+
+// Puts parked connections back to work while the thread runs fewer than its target, or while
+// requests of the log are due
+void socketUnpark(std::unique_ptr<threadData>& thread)
+{
+    uint64_t target = thread->target.load(std::memory_order_relaxed);
+    bool replaying = !thread->cfg.replayFile.empty();
+
+    while (!thread->parked.empty() && thread->conns.size() - thread->parkedCount < target)
+    {
+        int fd = thread->parked.back();
+
+        auto it = thread->conns.find(fd);
+        if (it == thread->conns.end() || !it->second->parked)
+        {
+            thread->parked.pop_back();
+            continue;
+        }
+
+        if (replaying && !replayTake(thread, it->second))
+            break;
+
+        thread->parked.pop_back();
+
+        it->second->parked = false;
+        thread->parkedCount--;
+
+        socketPhase(thread, it->second, WRITE);
+        thread->pending.push_back(fd);
+    }
+}
+
+// Gives the connection the earliest request of the log if it is due, false if none is
+bool replayTake(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    const replayEntry* next = replayPeek(thread->replay);
+    if (!next || next->due > clockNow_us())
+        return false;
+
+    replayRender(thread->replay, *next, conn->request);
+    conn->response.head = next->method == "HEAD";
+    conn->scheduled = next->due;
+
+    replayPop(thread->replay);
+    return true;
+}
+
+void socketPhase(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, phases phase)
+{
+    conn->phase = phase;
+    pollWatch(thread->poll, conn->fd, phase != READ);
+}
+
+template <typename Sock, Protocol P>
+bool socketCheck(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    switch (Sock::connect(conn, thread->cfg.targets[conn->endpoint].url.host))
+    {
+    case OK:    
+        break;
+    case ERR:
+        socketError(conn->target->errors.connect, conn->target->errors);
+        socketReconnect(thread, conn);
+        return false;        
+    case RETRY: 
+        return false;
+    }
+
+    // A WebSocket is connected once the upgrade is answered
+    if (P != Protocol::WEBSOCKET)
+        timingConnect(thread, conn);
+
+    // Users all connected at once start spread over a think time, not in lockstep
+    if (thread->cfg.think.kind != ThinkKind::NONE)
+    {
+        uint64_t pause = thinkDraw(thread->cfg.think, thread->random);
+        socketThink(thread, conn, std::uniform_int_distribution<uint64_t>(0, pause)(thread->random));
+        return false;
+    }
+
+    socketPhase(thread, conn, WRITE);
+
+    return true;
+}
+
+template <typename Sock, Protocol P>
+bool socketWrite(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    if (!conn->written)
+    {
+        // Connections above the --search target idle between rounds, replay connections until a request is due
+        if (conn->parked || thread->conns.size() - thread->parkedCount > thread->target.load(std::memory_order_relaxed) ||
+            (!thread->cfg.replayFile.empty() && !conn->scheduled && !replayTake(thread, conn)))
+        {
+            socketPark(thread, conn);
+            return false;
+        }
+
+        // Timed on the batch timestamp like everything else, no clock read of its own
+        conn->start = thread->now;
+
+        if (conn->scheduled)
+        {
+            // Latency of a replayed request counts from when it was due, waiting for a connection included
+            replayLag(thread->replay, thread->now - std::min(conn->scheduled, thread->now));
+            conn->start = std::min(conn->scheduled, thread->now);
+            conn->scheduled = 0;
+        }
+        conn->kernelSent = 0;
+        conn->kernelRead = 0;
+
+        // A WebSocket handshake is a round of its own
+        conn->pending = P == Protocol::WEBSOCKET && !conn->upgraded ? 1 : thread->cfg.pipeline;
+
+        if (thread->cfg.plan)
+        {
+            sessionRequest(*thread->cfg.plan, conn->flow, conn->request);
+            conn->response.head = thread->cfg.plan->steps[conn->flow.step].method == "HEAD";
+        }
+
+        // First byte deadline
+        timerArm(thread->timers, conn->timer, thread->now / 1000 + thread->cfg.timeout);
+    }
+
+    size_t total = conn->request.size() + (conn->payload ? conn->payload->size : 0);
+
+    // Partial sends resume from conn->written on the next writable edge
+    while (conn->written < total)
+    {
+        size_t n = 0;
+        switch (Sock::write(conn, n)) 
+        {
+        case OK:    
+            break;
+        case ERR: 
+            socketError(conn->target->errors.write, conn->target->errors);
+            socketReconnect(thread, conn);
+            return false;
+        case RETRY: 
+            return false;
+        }
+
+        conn->written += n;
+        thread->sent += n;
+    }
+
+    // A write that stalled finishes in a later batch, the upload shows up in Send and not in Wait
+    conn->sent = thread->now;
+    socketPhase(thread, conn, READ);
+
+    return true;
+}
+
+// Reads whatever arrived and hands it to the protocol, only framing state is kept in memory
+template <typename Sock, Protocol P>
+bool socketRead(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{    
+    httpResponse& response = conn->response;
+
+    while (true)
+    {
+        bool first = !conn->received;
+        uint64_t skip = P == Protocol::HTTP && thread->cfg.discard ? responseSkippable(response) : 0;
+
+        size_t n = 0;
+        status result = skip ? Sock::discard(conn, static_cast<size_t>(std::min<uint64_t>(skip, DISCARD_MAX)), n)
+            : Sock::read(conn, thread->scratch.data(), thread->scratch.size(), n);
+
+        switch (result)
+        {
+        case OK:    
+            break;
+        case ERR: 
+            socketError(conn->target->errors.read, conn->target->errors);
+            socketReconnect(thread, conn);
+            return false;
+        case RETRY: 
+            // MORE DATA INCOMING
+            if (!first && !thread->cfg.stream)
+                client.partial++;
+            return false;
+        }
+
+        if (!n)
+        {
+            // Closed by the server, only the end of a body without length or chunks
+            if (thread->cfg.stream && response.state != ResponseState::HEADER)
+            {
+                thread->stream.ended++;
+            }
+            else if (P == Protocol::HTTP && response.state == ResponseState::UNTIL_CLOSE)
+            {
+                setResults(thread, conn);
+            }
+            else
+            {
+                conn->target->errors.read++;
+                conn->target->errors.eof++;
+            }
+
+            socketReconnect(thread, conn);
+            return false;
+        }
+
+        thread->bytes += n;
+        conn->target->bytes += n;
+        conn->received += n;
+
+        // Full response deadline, counted from the first byte
+        if (first)
+        {
+            conn->firstByte = thread->now;
+            timerArm(thread->timers, conn->timer, thread->now / 1000 + thread->cfg.timeout);
+        }
+
+        if (thread->cfg.stream)
+            result = socketStream(thread, conn, n);
+        else if (skip)
+            result = socketSkip(thread, conn, n);
+        else if (conn->upgraded)
+            result = socketFrames(thread, conn, n);
+        else if (P == Protocol::TCP)
+            result = socketReplies(thread, conn, n);
+        else
+            result = socketResponses(thread, conn, n);
+
+        if (result == ERR)
+        {
+            socketReconnect(thread, conn);
+            return false;
+        }
+
+        if (result == OK)
+        {
+            timerCancel(thread->timers, conn->timer);
+
+            // Keep-alive, the next round goes out right away, or once the user has thought
+            conn->written = 0;
+            conn->received = 0;
+
+            if (thread->cfg.think.kind != ThinkKind::NONE)
+            {
+                socketThink(thread, conn, thinkDraw(thread->cfg.think, thread->random));
+                return false;
+            }
+
+            socketPhase(thread, conn, WRITE);
+
+            return true;
+        }
+    }
+}
+
+// Responses in the scratch buffer: OK once the round is answered, RETRY for more, ERR to drop
+status socketResponses(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, size_t n)
+{
+    httpResponse& response = conn->response;
+    const char* data = thread->scratch.data();
+    size_t used = 0;
+
+    bodyHandler handler = nullptr;
+    void* ctx = nullptr;
+
+    if (thread->cfg.plan && thread->cfg.plan->capture)
+    {
+        handler = sessionSpan;
+        ctx = conn.get();
+    }
+    else if (validateBody(thread->cfg.validate))
+    {
+        handler = validateSpan;
+        ctx = &conn->check;
+    }
+
+    while (true)
+    {
+        used += responseParse(response, data + used, n - used, handler, ctx);
+
+        if (responseFailed(response))
+        {
+            conn->target->errors.parse++;
+            return ERR;
+        }
+
+        if (!responseDone(response))
+            return RETRY;
+
+        if (response.upgrade)
+            return socketUpgrade(thread, conn, used < n);
+
+        setResults(thread, conn);
+
+        if (--conn->pending)
+        {
+            if (used == n)
+                return RETRY;
+
+            continue;
+        }
+
+        // Everything sent is answered, more bytes mean the framing is off
+        if (used < n)
+        {
+            conn->target->errors.parse++;
+            return ERR;
+        }
+
+        return OK;
+    }
+}
+
+// Body bytes dropped by --discard
+status socketSkip(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, size_t n)
+{
+    responseSkip(conn->response, n);
+
+    if (!responseDone(conn->response))
+        return RETRY;
+
+    setResults(thread, conn);
+
+    return --conn->pending ? RETRY : OK;
+}
+
+// Answer to the WebSocket handshake, from here on the connection carries frames
+status socketUpgrade(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, bool extra)
+{
+    if (conn->response.status != 101 || extra)
+    {
+        // Not switching, or frames the client did not ask for yet
+        if (conn->response.status == 101)
+            conn->target->errors.parse++;
+        else
+            conn->target->errors.status++;
+
+        return ERR;
+    }
+
+    responseReset(conn->response);
+    wsReset(conn->frames);
+
+    timingConnect(thread, conn);
+
+    conn->upgraded = true;
+    conn->request.clear();
+    conn->payload = thread->cfg.round.get();
+
+    return OK;
+}
+
+// Frames of an upgraded connection, every message answers one sent in this round
+status socketFrames(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, size_t n)
+{
+    uint64_t messages = 0;
+    bool closed = false;
+
+    size_t used = wsParse(conn->frames, thread->scratch.data(), n, messages, closed);
+
+    socketAnswered(thread, conn, messages);
+
+    if (closed)
+    {
+        conn->target->errors.read++;
+        conn->target->errors.eof++;
+        return ERR;
+    }
+
+    if (conn->pending)
+        return RETRY;
+
+    if (used < n || messages || conn->frames.have || conn->frames.payload)
+    {
+        conn->target->errors.parse++;
+        return ERR;
+    }
+
+    return OK;
+}
+
+// Replies of a tcp:// target, framed by --framing
+status socketReplies(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, size_t n)
+{
+    uint64_t messages = 0, errors = 0;
+    messageParser& p = conn->replies;
+
+    size_t used = messageParse(p, thread->cfg.framing, thread->scratch.data(), n, messages, errors);
+    conn->target->errors.status += static_cast<uint32_t>(errors);
+
+    if (p.failed)
+    {
+        conn->target->errors.parse++;
+        return ERR;
+    }
+
+    socketAnswered(thread, conn, messages);
+
+    if (conn->pending)
+        return RETRY;
+
+    // A reply nobody asked for, or the start of one
+    if (used < n || messages || p.payload || p.have || p.matched || p.line || p.depth)
+    {
+        conn->target->errors.parse++;
+        return ERR;
+    }
+
+    return OK;
+}
+
+// Bytes of a --stream response, which ends only when the server gives up on it: OK never comes
+status socketStream(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, size_t n)
+{
+    httpResponse& response = conn->response;
+    bool header = response.state == ResponseState::HEADER;
+
+    // Every event of this read arrived at once, at the batch timestamp
+    streamContext ctx{ thread, conn };
+    size_t used = responseParse(response, thread->scratch.data(), n, streamSpan, &ctx);
+
+    if (responseFailed(response))
+    {
+        conn->target->errors.parse++;
+        return ERR;
+    }
+
+    if (header && response.state != ResponseState::HEADER)
+    {
+        if (response.status < 200 || response.status > 299)
+        {
+            conn->target->errors.status++;
+            return ERR;
+        }
+
+        thread->stream.opened++;
+
+        // From here on the deadline is the longest gap between two events
+        timerArm(thread->timers, conn->timer, thread->now / 1000 + thread->cfg.timeout);
+    }
+
+    if (!responseDone(response))
+        return RETRY;
+
+    // A length or a last chunk: the stream is over, the next one goes out on a new connection
+    thread->stream.ended++;
+
+    if (used < n)
+        conn->target->errors.parse++;
+
+    return ERR;
+}
+
+// Body span handler of --stream
+void streamSpan(void* ctx, const char* data, size_t size)
+{
+    std::unique_ptr<threadData>& thread = static_cast<streamContext*>(ctx)->thread;
+    std::unique_ptr<connection>& conn = static_cast<streamContext*>(ctx)->conn;
+
+    const eventTime* time = thread->cfg.stamped ? &thread->cfg.eventStamp : nullptr;
+
+    for (size_t used = 0; used < size; )
+    {
+        bool event = false;
+        used += sseParse(conn->events, time, data + used, size - used, event);
+
+        if (event)
+            streamEvent(thread, conn);
+    }
+}
+
+// One event: the gap since the one before, the first counts from the request, and the
+// delivery time when the server stamped it
+void streamEvent(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    uint64_t gap = thread->now - std::min(conn->start, thread->now);
+    conn->start = thread->now;
+
+    thread->complete++;
+    thread->requests++;
+
+    if (!stats_record(thread->latency, gap))
+        conn->target->errors.timeout++;
+
+    if (thread->window)
+        stats_record(thread->window, gap);
+
+    targetRecord(conn, gap);
+
+    timerArm(thread->timers, conn->timer, thread->now / 1000 + thread->cfg.timeout);
+
+    if (!thread->cfg.stamped)
+        return;
+
+    uint64_t sent = conn->events.stamp_us;
+    int64_t arrived = static_cast<int64_t>(thread->now) + thread->epoch_us;
+
+    if (!sent)
+        thread->stream.unstamped++;
+    else if (arrived < static_cast<int64_t>(sent))
+        thread->stream.ahead++;
+    else
+        stats_record(thread->delivery, static_cast<uint64_t>(arrived) - sent);
+}
+
+// Round start to the batch that read the answer. One read in the same batch as its request took
+// less than the batch resolution, it counts as 1us rather than nothing
+uint64_t answerLatency(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    return std::max<uint64_t>(1, thread->now - std::min(conn->start, thread->now));
+}
+
+// Messages answering the round in flight, all timed from its start; the surplus is left in messages
+void socketAnswered(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, uint64_t& messages)
+{
+    if (!messages)
+        return;
+
+    uint64_t latency = answerLatency(thread, conn);
+
+    for (; messages && conn->pending; --messages, --conn->pending)
+    {
+        thread->complete++;
+        thread->requests++;
+
+        if (!stats_record(thread->latency, latency))
+            conn->target->errors.timeout++;
+
+        if (thread->window)
+            stats_record(thread->window, latency);
+
+        timingRecord(thread, conn);
+        targetRecord(conn, latency);
+
+        if (thread->cfg.kernelTime)
+            stampRecord(thread, conn, latency);
+    }
+}
+
+// The answer again in the numbers of its target, the histogram only when the run has several
+void targetRecord(std::unique_ptr<connection>& conn, uint64_t latency)
+{
+    endpointStats& target = *conn->target;
+    target.complete++;
+
+    if (target.latency)
+        stats_record(target.latency, latency);
+}
+
+// Socket created to connection usable, taken at the batch timestamps the loop already has
+void timingConnect(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    uint64_t connect = thread->now - std::min(conn->opened, thread->now);
+
+    stats_record(thread->timing.phase[TIMING_CONNECT], connect);
+
+    if (thread->window)
+        stats_record(thread->timingWindow.phase[TIMING_CONNECT], connect);
+}
+
+// Send, wait and transfer of an answer complete at thread->now. The round start, the last byte
+// written, the first byte read and the end are all batch timestamps, so no clock is read for them
+// and they add up to the latency
+void timingRecord(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{
+    uint64_t values[TIMINGS] = { 0, conn->sent - conn->start, conn->firstByte - conn->sent, thread->now - conn->firstByte };
+
+    for (int i = TIMING_SEND; i < TIMINGS; ++i)
+    {
+        stats_record(thread->timing.phase[i], values[i]);
+
+        if (thread->window)
+            stats_record(thread->timingWindow.phase[i], values[i]);
+    }
+}
+
+// The same answer between the kernel's timestamps: the transmit one of the round's last segment,
+// the receive one of the segment that completed the answer
+void stampRecord(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, uint64_t latency)
+{
+#ifdef __linux__
+    // Every transmit timestamp of the round is queued before its answer can arrive
+    if (!conn->kernelSent)
+        sockSentStamps(conn);
+#endif
+
+    if (!conn->kernelSent || conn->kernelRead < conn->kernelSent)
+    {
+        thread->unstamped++;
+        return;
+    }
+
+    uint64_t kernel = conn->kernelRead - conn->kernelSent;
+    uint64_t values[STAMPS] = { latency, kernel, latency - std::min(kernel, latency) };
+
+    for (int i = 0; i < STAMPS; ++i)
+        stats_record(thread->stamped[i], values[i]);
+}
+
+// Body span handler of a session that extracts from bodies, ctx is the connection
+void sessionSpan(void* ctx, const char* data, size_t size)
+{
+    connection* conn = static_cast<connection*>(ctx);
+
+    sessionCapture(conn->flow, data, size);
+
+    if (validateBody(*conn->check.rules))
+        validateSpan(&conn->check, data, size);
+}
+
+// Latency of the step just answered, then the session moves on with what it extracted
+void stepRecord(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn, uint64_t latency)
+{
+    size_t step = conn->flow.step;
+
+    stats_record(thread->steps[step].latency, latency);
+    stats_record(thread->steps[step].size, std::min<uint64_t>(conn->response.body, SIZE_LIMIT));
+
+    if (!sessionNext(*thread->cfg.plan, conn->flow, conn->response))
+        thread->misses[step]++;
+}
+
+void errorsMerge(errorsData& into, const errorsData& from)
+{
+    into.connect += from.connect;
+    into.read += from.read;
+    into.write += from.write;
+    into.timeout += from.timeout;
+    into.status += from.status;
+    into.validation += from.validation;
+    into.refused += from.refused;
+    into.reset += from.reset;
+    into.eof += from.eof;
+    into.parse += from.parse;
+}
+
+// Failed requests and connections, the refused, reset and eof details are already in these
+uint64_t errorsTotal(const errorsData& errors)
+{
+    return static_cast<uint64_t>(errors.connect) + errors.read + errors.write + errors.timeout + errors.status + errors.validation + errors.parse;
+}
+
+// Counts a failed socket call in its class and, when the cause is known, in the detail
+void socketError(uint32_t& counter, errorsData& errors)
+{
+    counter++;
+
+    if (sockRefused())
+        errors.refused++;
+    else if (sockReset())
+        errors.reset++;
+}
+
+void setResults(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+{   
+    int status = conn->response.status;
+
+    if (status < 0)
+    {
+        conn->target->errors.parse++;
+    }
+    else
+    {
+        uint64_t latency = answerLatency(thread, conn);
+
+        thread->complete++;
+        thread->requests++;
+
+        if (status > 399)
+            conn->target->errors.status++;
+
+        if (!stats_record(thread->latency, latency))
+        {
+            conn->target->errors.timeout++;
+        }
+
+        if (thread->window)
+            stats_record(thread->window, latency);
+
+        timingRecord(thread, conn);
+        targetRecord(conn, latency);
+
+        if (thread->cfg.kernelTime)
+            stampRecord(thread, conn, latency);
+
+        statusRecord(thread, status, latency, conn->response.body);
+
+        if (thread->cfg.plan)
+            stepRecord(thread, conn, latency);
+
+        int failed = validateEnd(conn->check, conn->response);
+        if (failed)
+        {
+            conn->target->errors.validation++;
+
+            if (failed & VALIDATE_STATUS) thread->mismatch.status++;
+            if (failed & VALIDATE_LENGTH) thread->mismatch.length++;
+            if (failed & VALIDATE_SUBSTRING) thread->mismatch.substring++;
+            if (failed & VALIDATE_HASH) thread->mismatch.hash++;
+        }
+    }
+
+    thread->body += conn->response.body;
+    responseReset(conn->response);
+}
+
+void statusInit(statusStats& status, uint64_t timeout)
+{
+    if (status.latency)
+        return;
+
+    status.latency = std::make_unique<stats>();
+    status.size = std::make_unique<stats>();
+    statsInit(status.latency, timeout * 1000);
+    statsInit(status.size, SIZE_LIMIT);
+}
+
+void statusRecord(std::unique_ptr<threadData>& thread, int status, uint64_t latency, uint64_t size)
+{
+    statusStats& code = thread->statuses[status];
+
+    // First response with this code
+    if (!code.latency)
+        statusInit(code, thread->cfg.timeout);
+
+    stats_record(code.latency, latency);
+    stats_record(code.size, std::min<uint64_t>(size, SIZE_LIMIT));
+}
+
+// One event of a connection as the HTTP loops handle it, for harnesses that drive a connection
+// themselves instead of a whole loop, such as mrk_bench
+template void socketEvent<plainSocket, Protocol::HTTP>(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+#ifdef __linux__
+template void socketEvent<stampedSocket, Protocol::HTTP>(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <mutex>
+#include <csignal>
+#include <random>
+
+#include "common.hpp"
+#include "net.hpp"
+#include "request.hpp"
+
+// Everything a run measured, merged from its workers by engineStop
+struct results
+{
+    uint64_t complete = 0;
+    uint64_t bytes = 0;
+    uint64_t sent = 0;
+    uint64_t body = 0;
+    uint64_t runtime_us = 0;
+    errorsData errors = {};
+    validationErrors mismatch = {};
+    std::vector<uint64_t> misses;       // extractions that found nothing, per scenario step
+    streamCounters stream = {};
+    uint64_t unstamped = 0;             // --kernel-time: answers without both kernel timestamps
+    bool kernelTimeDenied = false;
+    uint64_t thought_us = 0;            // --think: pauses of every user added up
+    std::vector<endpointStats> targets; // per URL, in the order given
+    statistics statis;
+};
+
+struct engine;
+void engineStop(engine&);
+
+// One load generation run: its configuration, workers and histograms. Nothing is global, so
+// one process can drive several runs at once; only the clock source is shared
+struct engine
+{
+    ~engine()
+    {
+        engineStop(*this);
+    }
+
+    config cfg;
+    std::atomic<bool> running{ false };
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<threadData>> threadsData;
+    std::chrono::high_resolution_clock::time_point start;
+    results result;
+};
+
+// What the body handler of --stream is given, it takes a single pointer
+struct streamContext
+{
+    std::unique_ptr<threadData>& thread;
+    std::unique_ptr<connection>& conn;
+};
+
+bool engineInit(engine&, const config&, std::string&);
+void engineStart(engine&);
+void engineCollect(engine&, std::unique_ptr<stats>&, timingStats* = nullptr);
+void engineTarget(engine&, uint64_t);
+bool engineDrained(engine&);
+std::vector<size_t> engineDeal(const config&, uint64_t);
+
+// A worker's event loop, instantiated for each socket policy and protocol and picked once per run
+typedef void (*threadEntry)(uint64_t, std::unique_ptr<threadData>&);
+threadEntry engineLoop(const config&);
+
+template <typename Sock, Protocol P> void threadMain(uint64_t, std::unique_ptr<threadData>&);
+void threadPin(int);
+void noiseRecord(std::unique_ptr<threadData>&, uint64_t);
+void windowFlush(std::unique_ptr<threadData>&);
+
+template <typename Sock, Protocol P> int socketConnect(std::unique_ptr<threadData>&, size_t);
+void socketReconnect(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void socketTimeout(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+template <typename Sock, Protocol P> void socketEvent(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+bool replayTake(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void socketPhase(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, phases);
+template <typename Sock, Protocol P> bool socketCheck(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+template <typename Sock, Protocol P> bool socketWrite(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void socketPark(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void socketThink(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, uint64_t);
+void socketWake(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void socketUnpark(std::unique_ptr<threadData>&);
+template <typename Sock, Protocol P> bool socketRead(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+status socketResponses(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, size_t);
+status socketSkip(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, size_t);
+status socketUpgrade(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, bool);
+status socketFrames(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, size_t);
+status socketReplies(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, size_t);
+status socketStream(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, size_t);
+void streamSpan(void*, const char*, size_t);
+void streamEvent(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void sessionSpan(void*, const char*, size_t);
+void stepRecord(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, uint64_t);
+void timingConnect(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void timingRecord(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void targetRecord(std::unique_ptr<connection>&, uint64_t);
+void stampRecord(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, uint64_t);
+uint64_t answerLatency(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void socketAnswered(std::unique_ptr<threadData>&, std::unique_ptr<connection>&, uint64_t&);
+
+void socketError(uint32_t&, errorsData&);
+void errorsMerge(errorsData&, const errorsData&);
+uint64_t errorsTotal(const errorsData&);
+
+void setResults(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
+void statusInit(statusStats&, uint64_t);
+void statusRecord(std::unique_ptr<threadData>&, int, uint64_t, uint64_t);
@@ -0,0 +1,349 @@
+#include "framing.hpp"
+#include "units.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// \r, \n, \t, \0, \\ and \xHH escapes of a --framing delimiter
+bool unescape(const std::string& input, std::string& output)
+{
+    output.clear();
+
+    for (size_t i = 0; i < input.size(); ++i)
+    {
+        if (input[i] != '\\')
+        {
+            output += input[i];
+            continue;
+        }
+
+        if (++i == input.size())
+            return false;
+
+        switch (input[i])
+        {
+        case 'r':  output += '\r'; break;
+        case 'n':  output += '\n'; break;
+        case 't':  output += '\t'; break;
+        case '0':  output += '\0'; break;
+        case '\\': output += '\\'; break;
+        case 'x':
+        {
+            std::string byte;
+            if (i + 2 >= input.size() || scanHex(input.substr(i + 1, 2), byte) || byte.size() != 1)
+                return false;
+
+            output += byte;
+            i += 2;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+
+    return !output.empty();
+}
+
+// fixed:N, delim:S (escapes allowed, default \r\n), length:N[le] with N of 1, 2, 4 or 8, or resp
+int scanFraming(std::string s, messageFraming& framing)
+{
+    std::string kind = s.substr(0, s.find(':'));
+    std::string arg = s.find(':') == std::string::npos ? "" : s.substr(s.find(':') + 1);
+
+    if (kind == "fixed")
+    {
+        framing.kind = Framing::FIXED;
+        if (scanMetric(arg, framing.size) || !framing.size)
+            return -1;
+    }
+    else if (kind == "delim")
+    {
+        framing.kind = Framing::DELIMITER;
+        if (!arg.empty() && !unescape(arg, framing.delimiter))
+            return -1;
+    }
+    else if (kind == "length")
+    {
+        framing.kind = Framing::LENGTH;
+
+        framing.little = arg.size() > 2 && arg.compare(arg.size() - 2, 2, "le") == 0;
+        if (framing.little || (arg.size() > 2 && arg.compare(arg.size() - 2, 2, "be") == 0))
+            arg.resize(arg.size() - 2);
+
+        if (!arg.empty() && (scanMetric(arg, framing.size) || (framing.size != 1 && framing.size != 2 && framing.size != 4 && framing.size != 8)))
+            return -1;
+
+        framing.prefix = arg.empty() ? 4 : static_cast<size_t>(framing.size);
+        framing.size = 0;
+    }
+    else if (kind == "resp" && arg.empty())
+    {
+        framing.kind = Framing::RESP;
+    }
+    else
+    {
+        return -1;
+    }
+
+    // Longest proper prefix of delimiter[0..i] that is also its suffix
+    const std::string& d = framing.delimiter;
+    framing.fallback.assign(d.size(), 0);
+
+    for (size_t i = 1, k = 0; i < d.size(); ++i)
+    {
+        while (k && d[i] != d[k])
+            k = framing.fallback[k - 1];
+        if (d[i] == d[k])
+            k++;
+        framing.fallback[i] = k;
+    }
+
+    return 0;
+}
+
+void messageReset(messageParser& p)
+{
+    p.payload = false;
+    p.remaining = 0;
+    p.matched = 0;
+    p.have = 0;
+    p.line = false;
+    p.type = 0;
+    p.number = 0;
+    p.negative = false;
+    p.error = false;
+    p.depth = 0;
+    p.failed = false;
+}
+
+// One RESP value is complete: closes the aggregates it finishes, then maybe the reply
+void respValue(messageParser& p, uint64_t& messages, uint64_t& errors)
+{
+    while (p.depth)
+    {
+        if (--p.elements[p.depth - 1])
+            return;
+
+        p.depth--;
+    }
+
+    messages++;
+    if (p.error)
+        errors++;
+
+    p.error = false;
+}
+
+// End of a RESP type line, the number holds its length or count
+void respLine(messageParser& p, uint64_t& messages, uint64_t& errors)
+{
+    p.line = false;
+
+    // Error replies still count as replies, they are reported on their own
+    if ((p.type == '-' || p.type == '!') && !p.depth)
+        p.error = true;
+
+    switch (p.type)
+    {
+    case '$':
+    case '=':
+    case '!':
+        if (p.negative)
+            break;
+
+        // Blob and its closing \r\n
+        p.remaining = p.number + 2;
+        p.payload = true;
+        return;
+    case '*':
+    case '~':
+    case '>':
+    case '%':
+        if (p.negative || !p.number)
+            break;
+
+        if (p.depth == RESP_DEPTH_MAX)
+        {
+            p.failed = true;
+            return;
+        }
+
+        p.elements[p.depth++] = p.type == '%' ? p.number * 2 : p.number;
+        return;
+    case '+':
+    case '-':
+    case ':':
+    case '_':
+    case ',':
+    case '#':
+    case '(':
+        break;
+    default:
+        p.failed = true;
+        return;
+    }
+
+    respValue(p, messages, errors);
+}
+
+// Type lines are short, simple strings and errors are skipped to their \n with memchr
+size_t respParse(messageParser& p, const char* data, size_t size, uint64_t& messages, uint64_t& errors)
+{
+    size_t i = 0;
+
+    while (i < size && !p.failed)
+    {
+        if (p.payload)
+        {
+            uint64_t n = std::min<uint64_t>(p.remaining, size - i);
+
+            p.remaining -= n;
+            i += n;
+
+            if (!p.remaining)
+            {
+                p.payload = false;
+                respValue(p, messages, errors);
+            }
+
+            continue;
+        }
+
+        if (!p.line)
+        {
+            p.type = data[i++];
+            p.number = 0;
+            p.negative = false;
+            p.line = true;
+            continue;
+        }
+
+        const char* end = static_cast<const char*>(memchr(data + i, '\n', size - i));
+        size_t stop = end ? end - data : size;
+
+        if (strchr("$=!*~>%", p.type))
+        {
+            for (; i < stop; ++i)
+            {
+                char c = data[i];
+
+                if (c >= '0' && c <= '9')
+                    p.number = p.number * 10 + (c - '0');
+                else if (c == '-' && !p.number)
+                    p.negative = true;
+                else if (c != '\r')
+                    p.failed = true;
+            }
+        }
+
+        i = stop;
+        if (!end)
+            break;
+
+        i++;
+        respLine(p, messages, errors);
+    }
+
+    return i;
+}
+
+// Matches the delimiter byte by byte only after memchr found its first byte
+size_t delimiterParse(messageParser& p, const messageFraming& framing, const char* data, size_t size, uint64_t& messages)
+{
+    const std::string& d = framing.delimiter;
+    size_t i = 0;
+
+    while (i < size)
+    {
+        if (!p.matched)
+        {
+            const char* first = static_cast<const char*>(memchr(data + i, d[0], size - i));
+            if (!first)
+                return size;
+
+            i = first - data + 1;
+            p.matched = 1;
+        }
+        else
+        {
+            char c = data[i++];
+
+            while (p.matched && c != d[p.matched])
+                p.matched = framing.fallback[p.matched - 1];
+
+            if (c == d[p.matched])
+                p.matched++;
+        }
+
+        if (p.matched == d.size())
+        {
+            messages++;
+            p.matched = 0;
+        }
+    }
+
+    return i;
+}
+
+// Consumes replies, adds the complete ones to messages and the RESP error replies to errors
+size_t messageParse(messageParser& p, const messageFraming& framing, const char* data, size_t size, uint64_t& messages, uint64_t& errors)
+{
+    if (framing.kind == Framing::RESP)
+        return respParse(p, data, size, messages, errors);
+
+    if (framing.kind == Framing::DELIMITER)
+        return delimiterParse(p, framing, data, size, messages);
+
+    size_t i = 0;
+
+    while (i < size)
+    {
+        if (p.payload)
+        {
+            uint64_t n = std::min<uint64_t>(p.remaining, size - i);
+
+            p.remaining -= n;
+            i += n;
+
+            if (!p.remaining)
+            {
+                p.payload = false;
+                messages++;
+            }
+
+            continue;
+        }
+
+        if (framing.kind == Framing::FIXED)
+        {
+            p.remaining = framing.size;
+            p.payload = true;
+            continue;
+        }
+
+        size_t n = std::min(framing.prefix - p.have, size - i);
+        memcpy(p.header + p.have, data + i, n);
+        p.have += n;
+        i += n;
+
+        if (p.have < framing.prefix)
+            break;
+
+        p.remaining = 0;
+        for (size_t b = 0; b < framing.prefix; ++b)
+        {
+            size_t at = framing.little ? framing.prefix - 1 - b : b;
+            p.remaining = (p.remaining << 8) | p.header[at];
+        }
+
+        p.have = 0;
+
+        if (p.remaining)
+            p.payload = true;
+        else
+            messages++;
+    }
+
+    return i;
+}
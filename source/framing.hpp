@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Nesting of RESP arrays and maps followed by the parser
+#define RESP_DEPTH_MAX      32
+
+enum class Framing
+{
+    FIXED,          // every reply is size bytes
+    DELIMITER,      // replies end with delimiter, e.g. \r\n
+    LENGTH,         // prefix bytes of length, then that many bytes
+    RESP            // Redis serialization protocol, RESP2 and the RESP3 scalars and aggregates
+};
+
+// How replies of a tcp:// target are delimited, from --framing
+struct messageFraming
+{
+    Framing kind = Framing::DELIMITER;
+    uint64_t size = 0;
+    std::string delimiter = "\r\n";
+    std::vector<size_t> fallback;       // KMP table of delimiter, matches survive split reads
+    size_t prefix = 4;
+    bool little = false;
+};
+
+// Incremental reply parser, no allocation, nothing of the payload is kept
+struct messageParser
+{
+    bool payload = false;
+    uint64_t remaining = 0;
+    size_t matched = 0;
+    unsigned char header[8];
+    size_t have = 0;
+
+    // RESP
+    bool line = false;
+    char type = 0;
+    uint64_t number = 0;
+    bool negative = false;
+    bool error = false;
+    int depth = 0;
+    uint64_t elements[RESP_DEPTH_MAX];
+
+    bool failed = false;
+};
+
+int scanFraming(std::string, messageFraming&);
+
+void messageReset(messageParser&);
+size_t messageParse(messageParser&, const messageFraming&, const char*, size_t, uint64_t&, uint64_t&);
@@ -1,18 +1,105 @@
 
 #include "mrk.hpp"
 
+const std::vector<argOption> options =
+{
+    { "connections", true,  'c' },
+    { "weights",     true,  'w' },
+    { "users",       true,  'U' },
+    { "think",       true,  'j' },
+    { "duration",    true,  'd' },
+    { "threads",     true,  't' },
+    { "timeout",     true,  'T' },
+    { "client-stats", false, 'C' },
+    { "perf-counters", false, 'G' },
+    { "clock",       true,  'K' },
+    { "busy-poll",   false, 'B' },
+    { "so-busy-poll", true, 'P' },
+    { "pin",         true,  'p' },
+    { "kernel-time", false, 'k' },
+    { "interval",    true,  'I' },
+    { "interval-log", true, 'l' },
+    { "heatmap",     false, 'M' },
+    { "search",      true,  'z' },
+    { "step",        true,  'Y' },
+    { "save",        true,  'o' },
+    { "compare",     true,  'r' },
+    { "threshold",   true,  'q' },
+    { "replay",      true,  'R' },
+    { "speedup",     true,  'x' },
+    { "stream",      false, 'E' },
+    { "event-time",  true,  'e' },
+    { "pipeline",    true,  'N' },
+    { "host",        true,  'H' },
+    { "ws-size",     true,  'W' },
+    { "payload",     true,  'y' },
+    { "framing",     true,  'f' },
+    { "method",      true,  'm' },
+    { "body-file",   true,  'b' },
+    { "scenario",    true,  's' },
+    { "discard",     false, 'D' },
+    { "expect-status", true, 'S' },
+    { "expect-length", true, 'L' },
+    { "expect-substring", true, 'F' },
+    { "expect-hash", true,  'X' },
+    { "version",     false, 'v' },
+    { "help",        false, 'h' },
+};
+
 void usage() 
 {
-    printf("Usage: mrk <options> <url>                            \n"
+    printf("Usage: mrk <options> <url> [<url>...]             \n"
         "  Options:                                            \n"
         "    -c, --connections <N>  Connections to keep open   \n"
+        "        --weights     <L>  Connection share per URL   \n"
+        "        --users       <N>  Virtual users, one conn each\n"
+        "        --think       <D>  User pause: 1s, uniform:1s,3s\n"
+        "                           exp:2s, lognormal:1s,0.5   \n"
         "    -d, --duration    <T>  Duration of test           \n"
         "    -t, --threads     <N>  Number of threads to use   \n"
+        "    -T, --timeout     <T>  Socket/request timeout     \n"
+        "    -m, --method      <M>  Request method             \n"
+        "    -b, --body-file   <F>  Send file F as request body\n"
+        "    -s, --scenario    <F>  Run the steps of file F    \n"
+        "        --discard          Drop bodies unread (kernel)\n"
+        "        --expect-status <L>     Valid statuses (200,3xx)\n"
+        "        --expect-length <N>     Exact body length       \n"
+        "        --expect-substring <S>  Body must contain S     \n"
+        "        --expect-hash <H|@F>    Body xxHash64, or of F  \n"
+        "        --client-stats     Print client overhead stats\n"
+        "        --perf-counters    Count cycles, misses per req\n"
+        "        --clock       <S>  Timestamp source: tsc, mono\n"
+        "        --busy-poll        Spin instead of sleeping   \n"
+        "        --so-busy-poll <U> Set SO_BUSY_POLL to U us   \n"
+        "        --pin         <L>  Pin threads to CPUs (0,2-5)\n"
+        "        --kernel-time      Also time by kernel stamps \n"
+        "        --interval    <T>  Timeline interval (1s)     \n"
+        "        --interval-log <F> Write interval histograms  \n"
+        "        --heatmap          Print latency over time    \n"
+        "        --search      <S>  Find max load within SLO S \n"
+        "                           e.g. p99<50ms,max<1s       \n"
+        "        --step        <T>  Length of a search step    \n"
+        "        --save        <F>  Save run as a baseline     \n"
+        "        --compare     <F>  Compare with baseline F    \n"
+        "        --threshold   <L>  Tolerated change, in %%     \n"
+        "                           e.g. rps=5,p99=10          \n"
+        "        --replay      <F>  Replay access log F        \n"
+        "        --speedup     <X>  Replay X times faster (1)  \n"
+        "        --stream           Hold responses open as SSE \n"
+        "        --event-time  <J>  Event sent time, json field\n"
+        "                           J of the data, or id       \n"
+        "        --pipeline    <N>  Requests sent per round    \n"
+        "    -H, --host        <H>  Host header, e.g. for unix:\n"
+        "        --ws-size     <N>  WebSocket message size     \n"
+        "        --payload     <H>  tcp:// request bytes as hex\n"
+        "        --framing     <F>  tcp:// replies: fixed:N,   \n"
+        "                           delim:S, length:N[le], resp\n"
         "                                                      \n"
         "    -v, --version          Print version details      \n"
         "                                                      \n"
         "  Numeric arguments may include a SI unit (1k, 1M, 1G)\n"
-        "  Time arguments may include a time unit (2s, 2m, 2h)\n");
+        "  Time arguments may include a time unit (2s, 2m, 2h)\n"
+        "  Timeouts also accept milliseconds (500ms)          \n");
 }
 
 int main(int argc, char** argv)
@@ -25,399 +112,718 @@ int main(int argc, char** argv)
         usage();
         return 0;
     }
+
+    if (cfg.thresholds.empty())
+        scanThresholds(COMPARE_THRESHOLDS, cfg.thresholds);
         
-    cfg.url = parseURL(url);
+    cfg.url = cfg.targets.front().url;
 
-    if (cfg.url.schema == "https")
+    timeline line;
+    bool recording = !cfg.saveFile.empty() || !cfg.compareFile.empty();
+    bool timed = cfg.heatmap || !cfg.intervalLog.empty() || recording;
+    bool searching = !cfg.search.rules.empty();
+    bool replaying = !cfg.replayFile.empty();
+
+    if (timed && searching)
     {
-        // TO DO
-        return 0;
+        printf("--search takes the latency of every step from the workers, it cannot be combined with --heatmap,\n"
+            "--interval-log, --save or --compare\n");
+        return 1;
     }
-    else
+
+    cfg.sampling = timed || searching;
+
+    engine load;
+    std::string error;
+
+    if (!engineInit(load, cfg, error))
     {
-        sock = { sockConnect, sockReadable, sockWrite, sockRead, sockClose };
+        printf("%s\n", error.c_str());
+        return 1;
     }
 
-    statsInit(statis.latency, cfg.timeout * 1000);
-    statsInit(statis.requests, MAX_THREAD_RATE_S);
+    // Prepared by the engine, a replay without -d runs as long as its log
+    cfg = load.cfg;
 
-    threads.resize(cfg.threads);
+    // Runs are compared interval by interval, both are kept that way
+    baseline before, run;
+    run.url = url;
+    run.connections = cfg.connections;
+    run.threads = cfg.threads;
+    run.limit_us = cfg.timeout * 1000;
 
-    std::vector<std::unique_ptr<threadData>> threadsData;
-    threadsData.resize(cfg.threads);
-    
-    isRunning.store(true);
+    if (!cfg.compareFile.empty())
+    {
+        if (!baselineLoad(cfg.compareFile, before, error))
+        {
+            printf("Baseline %s: %s\n", cfg.compareFile.c_str(), error.c_str());
+            return 1;
+        }
+    }
 
-    for (uint64_t i = 0; i < cfg.threads; ++i) 
+    if (timed && !timelineInit(line, cfg.intervalLog, cfg.interval, cfg.timeout * 1000))
     {
-        std::unique_ptr<threadData> data = std::make_unique<threadData>();
-        data->cfg = cfg;
-        data->connections = cfg.connections / cfg.threads;
-        
-        threadsData.at(i) = std::move(data);
-        
-        threads.emplace_back(std::thread(&threadMain, i + 1, std::ref(threadsData.at(i))));
+        printf("Cannot write interval log %s\n", cfg.intervalLog.c_str());
+        return 1;
     }
 
+    engineStart(load);
+
     std::string time = formatTime_s(cfg.duration);
-    std::cout << "Running mrk for " << time << " @ " << url << std::endl;
+    if (searching)
+        std::cout << "Running mrk search @ " << url << std::endl;
+    else if (replaying)
+        std::cout << "Running mrk replay of " << cfg.replayFile << " at " << formatMetric(cfg.speedup) << "x"
+            << (cfg.capped ? " for " + time : "") << " @ " << url << std::endl;
+    else
+        std::cout << "Running mrk for " << time << " @ " << url << std::endl;
     std::cout << "  " << cfg.threads << " threads and " << cfg.connections << " connections" << std::endl;
+    if (cfg.body)
+        std::cout << "  " << formatBinary(cfg.body->size) << "B body from " << cfg.bodyFile << std::endl;
 
-    auto start = timeNow();
-    uint64_t complete = 0;
-    uint64_t bytes = 0;
-    uint64_t sent = 0;
-    errorsData errors = {};
+    auto start = load.start;
+    uint64_t closed_ms = 0;
 
-    std::this_thread::sleep_for(std::chrono::seconds(cfg.duration));
-    
-    isRunning.store(false);
-        
-    for (auto& t : threadsData)
+    if (searching)
+    {
+        searchRun(load);
+    }
+    else if (timed)
     {
-        complete += t->complete;
-        bytes += t->bytes;
-        sent += t->sent;
+        // Wake up at every interval boundary to close it, the workers keep going
+        uint64_t total_ms = cfg.duration * 1000;
+
+        for (uint64_t elapsed = 0; elapsed < total_ms; )
+        {
+            elapsed = std::min(elapsed + cfg.interval, total_ms);
+            bool going = waitUntil(start + std::chrono::milliseconds(elapsed), load);
 
-        errors.connect += t->errors.connect;
-        errors.read += t->errors.read;
-        errors.write += t->errors.write;
-        errors.timeout += t->errors.timeout;
-        errors.status += t->errors.status;
+            if (elapsed < total_ms && going)
+            {
+                intervalCollect(line, load, recording ? &run : nullptr, cfg.interval);
+                closed_ms = elapsed;
+            }
+
+            if (!going)
+                break;
+        }
+    }
+    else
+    {
+        waitUntil(start + std::chrono::seconds(cfg.duration), load);
     }
     
-    auto runtime_us = getTime_us(start);
-    auto runtime_s = getTime_s(start);
-    auto req_per_s = complete / runtime_s;
-    auto bytes_per_s = bytes / runtime_s;
+    engineStop(load);
+
+    results& result = load.result;
+    statistics& statis = result.statis;
+    auto runtime_us = result.runtime_us;
+    uint64_t complete = result.complete;
+    uint64_t bytes = result.bytes;
+    errorsData& errors = result.errors;
 
-    if (complete / cfg.connections > 0) 
+    if (timed)
+    {
+        // The last interval, up to the final samples of every worker
+        uint64_t last_ms = std::max<uint64_t>(1, runtime_us / 1000 - std::min<uint64_t>(closed_ms, runtime_us / 1000));
+        intervalCollect(line, load, recording ? &run : nullptr, last_ms);
+        timelineClose(line);
+    }
+        
+    // From microseconds, a replay can end within the first second
+    auto runtime = std::max<long long>(1, runtime_us);
+    auto req_per_s = complete * 1000000 / runtime;
+    auto bytes_per_s = bytes * 1000000 / runtime;
+
+    // Search steps run fewer connections than -c, the expected interval is unknown. Replayed
+    // requests are timed from when they were due, nothing was omitted
+    uint64_t busy_us = statis.latency->sum;
+
+    // Users that think are a closed loop, their next request waits for the answer by design
+    int64_t interval = 0;
+    bool thinking = cfg.think.kind != ThinkKind::NONE;
+    if (!searching && !replaying && !cfg.stream && !thinking && complete / cfg.connections > 0) 
     {
-        int64_t interval = runtime_us / (complete / cfg.connections);
+        interval = runtime_us / (complete / cfg.connections);
         stats_correct(statis.latency, interval);
     }
 
     printf("  Thread Stats%6s%11s%8s%12s\n", "Avg", "Stdev", "Max", "+/- Stdev");
 
-    printStats("Latency", statis.latency, formatTime_us);
+    // The latency of a stream is the gap before each event
+    printStats(cfg.stream ? "Gap" : "Latency", statis.latency, formatTime_us);
+    if (statis.delivery->count)
+        printStats("Delivery", statis.delivery, formatTime_us);
     printStats("Req/Sec", statis.requests, formatMetric);
     
     std::string runtime_msg = formatTime_us(runtime_us, 0);
 
-    printf("  %d requests in %s, %sB sent, %sB read\n", (int)complete, runtime_msg.c_str(), formatBinary(sent).c_str(), formatBinary(bytes).c_str());
+    const char* unit = cfg.stream ? "events" : cfg.protocol == Protocol::HTTP ? "requests" : "messages";
+
+    printf("  %d %s in %s, %sB sent, %sB read\n", (int)complete, unit, runtime_msg.c_str(), formatBinary(result.sent).c_str(), formatBinary(bytes).c_str());
+    if (cfg.users || thinking)
+        printUsers(cfg, result, busy_us);
+
     if (errors.connect || errors.read || errors.write || errors.timeout) 
     {
         printf("  Socket errors: connect %d, read %d, write %d, timeout %d\n",
                 errors.connect, errors.read, errors.write, errors.timeout);
     }
 
-    if (errors.status) 
+    if (errors.refused || errors.reset || errors.eof || errors.parse)
+    {
+        printf("  Error detail: refused %d, reset %d, closed mid-response %d, parse %d\n",
+                errors.refused, errors.reset, errors.eof, errors.parse);
+    }
+
+    if (errors.status && cfg.protocol == Protocol::TCP)
+        printf("  Error replies: %d\n", errors.status);
+    else if (errors.status) 
         printf("  Non-2xx or 3xx responses: %d\n", errors.status);
+
+    if (errors.validation)
+    {
+        printf("  Validation errors: %d (status %d, length %d, substring %d, hash %d)\n", errors.validation,
+            result.mismatch.status, result.mismatch.length, result.mismatch.substring, result.mismatch.hash);
+    }
     
-    printf("Requests/sec: %9.2lld\n", static_cast<long long>(req_per_s));
+    if (replaying)
+        printReplay(cfg, load.threadsData);
+
+    if (cfg.stream)
+        printStream(cfg, result);
+
+    if (complete)
+        printTiming(statis);
+
+    if (complete)
+        printStatuses(cfg, statis, interval);
+
+    if (cfg.plan && complete)
+        printSteps(cfg, statis, interval, result.misses);
+
+    if (cfg.targets.size() > 1)
+        printTargets(cfg, result, interval > 0);
+
+    const char* rate = cfg.stream ? "Events/sec" : cfg.protocol == Protocol::HTTP ? "Requests/sec" : "Messages/sec";
+    printf("%s: %9.2lld\n", rate, static_cast<long long>(req_per_s));
     printf("Transfer/sec: %10sB\n", formatBinary(bytes_per_s).c_str());
-    
-    for(auto& t : threads)    
-        if(t.joinable())        
-            t.join();
-    
-    return 91;
-}
 
-void threadMain(uint64_t id, std::unique_ptr<threadData>& thread)
-{
-    FD_ZERO(&thread->fds);
+    if (cfg.discard && complete)
+    {
+        // Latency is taken at the last byte of the response
+        long double ttlb_us = stats_mean(statis.latency);
+        long double size = result.body / (long double)complete;
 
-    for (uint64_t i = 0; i < thread->connections; ++i)
-        socketConnect(thread);
+        printf("  Body avg %sB, time to last byte avg %s, %sB/s per connection\n", formatBinary(size).c_str(),
+            formatTime_us(ttlb_us).c_str(), formatBinary(ttlb_us > 0 ? size * 1000000 / ttlb_us : 0).c_str());
+    }
+
+    if (cfg.heatmap)
+        timelinePrint(line);
+
+    if (cfg.kernelTime)
+        printStamps(result);
 
-    fd_set write_fds, read_fds;
-    FD_ZERO(&write_fds);
-    FD_ZERO(&read_fds);
+    if (cfg.busyPoll)
+        printNoise(load.threadsData);
 
-    struct timeval timeout;
-    timeout.tv_sec = 10; 
-    timeout.tv_usec = 0;
+    if (cfg.clientStats)
+        printClientStats(load.threadsData);
 
-    thread->start = timeNow(RECORD_INTERVAL_MS);
+    if (cfg.perfCounters)
+        printPerf(load.threadsData);
 
-    while (isRunning.load())
+    if (!cfg.saveFile.empty() && !baselineSave(cfg.saveFile, run))
     {
-        write_fds = thread->fds;    
-        read_fds = thread->fds;    
-    
-        int ready_fds = select(thread->max + 1, &read_fds, &write_fds, NULL, &timeout);
-        if (ready_fds == -1)             
-            break;
-        
-        for (int i = 0; i < thread->fd.size(); ++i)
-        {            
-            if (FD_ISSET(thread->fd[i], &write_fds) || FD_ISSET(thread->fd[i], &read_fds))
-            {
-                std::unique_ptr<connection>& conn = std::ref(thread->conns[thread->fd[i]]);                
-                if (conn->phase == CONNECT)
-                    socketCheck(thread, conn);
-                else if (conn->phase == WRITE)
-                    socketWrite(thread, conn);
-                else if (conn->phase == READ)
-                    socketRead(thread, conn);
-            }
-        }
-        
-        if (hasTimePassed(thread->start, RECORD_INTERVAL_MS))
-        {
-            uint64_t elapsed_ms = getTime_us(thread->start) / 1000;
-            uint64_t requests = (thread->requests / (double)elapsed_ms) * 1000;
+        printf("Cannot write baseline %s\n", cfg.saveFile.c_str());
+        return 1;
+    }
 
-            stats_record(statis.requests, requests);
+    if (!cfg.compareFile.empty())
+    {
+        if (before.url != run.url || before.connections != run.connections || before.threads != run.threads)
+        {
+            printf("  Baseline ran %s with %llu threads and %llu connections\n", before.url.c_str(),
+                (unsigned long long)before.threads, (unsigned long long)before.connections);
+        }
 
-            thread->requests = 0;
-            thread->start = timeNow(RECORD_INTERVAL_MS);
-        }        
+        if (comparePrint(baselineCompare(before, run, cfg.thresholds), cfg.compareFile))
+            return EXIT_REGRESSION;
     }
+
+    return 0;
 }
 
-int socketConnect(std::unique_ptr<threadData>& thread) 
+// Sleeps until the deadline, false if every worker finished its replay before it
+bool waitUntil(std::chrono::high_resolution_clock::time_point deadline, engine& load)
 {
-#ifdef _WIN32
-    WSADATA wsaData;
-
-    int wsaResult = WSAStartup(MAKEWORD(2, 0), &wsaData);
-    if (wsaResult != 0)
+    if (load.cfg.replayFile.empty())
     {
-        printf("WSAStartup failed with error: %d\n", wsaResult);
-        return 0;
+        std::this_thread::sleep_until(deadline);
+        return true;
     }
-#endif
-        
-    int fd, flags;
-    if ((fd = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0)
+
+    while (timeNow() < deadline)
     {
-        printf("Cannot create socket\n");
-        return 0;
+        if (engineDrained(load))
+            return false;
+
+        std::this_thread::sleep_until(std::min(deadline, timeNow() + std::chrono::milliseconds(REPLAY_POLL_MS)));
     }
-    
-#ifdef _WIN32    
-    u_long mode = 1;
-    if (ioctlsocket(fd, FIONBIO, &mode) != 0)
-#else
-    flags = fcntl(fd, F_GETFL, 0);
-    if (!fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
-#endif
+
+    return true;
+}
+
+// Closes the current timeline interval with what every worker handed over so far, and keeps
+// it for --save and --compare when run is set
+void intervalCollect(timeline& line, engine& load, baseline* run, uint64_t length_ms)
+{
+    engineCollect(load, line.current, &line.timing);
+
+    if (run)
+        baselineAdd(*run, line.current, length_ms);
+
+    timelineAdd(line);
+}
+
+// Runs steps of --step seconds at the concurrency the search asks for, on connections opened once
+void searchRun(engine& load)
+{
+    const config& cfg = load.cfg;
+    search s;
+    s.max = cfg.connections;
+
+    // Latency right after a change is the transition, not the new level
+    auto settle = std::chrono::milliseconds(std::min<uint64_t>(1000, cfg.step * 200));
+
+    printf("  Searching for the highest load within %s, %s steps\n", cfg.search.text.c_str(), formatTime_s(cfg.step).c_str());
+    searchPrintHeader();
+
+    uint64_t concurrency;
+    while ((concurrency = searchNext(s)))
     {
-        printf("Problems with not-blocking\n");
-        sock.close(fd);
-        return 0;
+        engineTarget(load, concurrency);
+
+        searchStep step;
+        step.concurrency = concurrency;
+        step.latency = std::make_unique<stats>();
+        statsInit(step.latency, cfg.timeout * 1000);
+
+        std::this_thread::sleep_for(settle);
+        engineCollect(load, step.latency);
+        stats_reset(step.latency);
+
+        auto begin = timeNow();
+        std::this_thread::sleep_for(std::chrono::seconds(cfg.step));
+        engineCollect(load, step.latency);
+
+        long double elapsed = std::max<long long>(1, getTime_us(begin)) / 1e6L;
+        step.rate = step.latency->count / elapsed;
+        step.met = sloMet(cfg.search, step.latency);
+
+        searchPrintStep(step);
+        searchRecord(s, std::move(step));
     }
 
-    addrinfo hints{}, * result = nullptr;
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    if (getaddrinfo(thread->cfg.url.host.c_str(), thread->cfg.url.port.c_str(), &hints, &result) != 0)
+    searchPrint(s, cfg.search);
+}
+
+// Responses are counted from the size histogram, latency may hold corrected samples
+void printStatus(std::string name, statusStats& status)
+{
+    long double size = stats_mean(status.size);
+
+    printf("    %-8s", name.c_str());
+    printUnits(status.size->count, formatMetric, 8);
+    printUnits(stats_mean(status.latency), formatTime_us, 9);
+    printUnits(stats_percentile(status.latency, 50.0), formatTime_us, 9);
+    printUnits(stats_percentile(status.latency, 99.0), formatTime_us, 9);
+    printUnits(status.latency->max, formatTime_us, 9);
+    printUnits(size, formatBytes, 10);
+    printUnits(stats_percentile(status.size, 99.0), formatBytes, 10);
+    printf("\n");
+}
+
+// Latency and body size per scenario step, in the order of the file
+void printSteps(const config& cfg, statistics& statis, int64_t interval, const std::vector<uint64_t>& misses)
+{
+    printf("  Step%13s%9s%9s%9s%9s%10s%10s\n", "Count", "Avg", "p50", "p99", "Max", "Size", "Size p99");
+
+    bool missed = false;
+
+    for (size_t step = 0; step < statis.steps.size(); ++step)
     {
-        printf("getaddrinfo failed\n");
-        sock.close(fd);
-        return 0;
+        stats_correct(statis.steps[step].latency, interval);
+        printStatus(cfg.plan->steps[step].name, statis.steps[step]);
+
+        missed |= misses[step] != 0;
     }
-    
-    sockaddr_in serveraddr{};
-    serveraddr.sin_family = AF_INET;
-    serveraddr.sin_addr.s_addr = reinterpret_cast<sockaddr_in*>(result->ai_addr)->sin_addr.s_addr;
-    serveraddr.sin_port = htons(std::stoi(thread->cfg.url.port));
-    if (connect(fd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) < 0)
-    {        
-#ifdef _WIN32
-        if (WSAGetLastError() != WSAEWOULDBLOCK) 
-#else
-        if (errno != EINPROGRESS)
-#endif
+
+    if (!missed)
+        return;
+
+    printf("  Extractions that found nothing, the session started over:");
+    for (size_t step = 0; step < misses.size(); ++step)
+        printf(" %s %llu%s", cfg.plan->steps[step].name.c_str(), (unsigned long long)misses[step], step + 1 < misses.size() ? "," : "\n");
+}
+
+// Latency and body size per status class, the most frequent codes listed under their class
+void printStatuses(const config& cfg, statistics& statis, int64_t interval)
+{
+    std::vector<int> top;
+    for (int code = 0; code < HTTP_STATUS_MAX; ++code)
+        if (statis.statuses[code].latency)
+            top.push_back(code);
+
+    std::stable_sort(top.begin(), top.end(), [&statis](int a, int b) {
+        return statis.statuses[a].size->count > statis.statuses[b].size->count;
+    });
+
+    if (top.empty())
+        return;
+
+    if (top.size() > STATUS_TOP)
+        top.resize(STATUS_TOP);
+
+    printf("  Status%11s%9s%9s%9s%9s%10s%10s\n", "Count", "Avg", "p50", "p99", "Max", "Size", "Size p99");
+
+    for (int group = 0; group < HTTP_STATUS_MAX / 100; ++group)
+    {
+        statusStats total;
+        statusInit(total, cfg.timeout);
+
+        for (int code = group * 100; code < (group + 1) * 100; ++code)
         {
-            socketErrorConnect(thread->errors.connect);
-            sock.close(fd);
-            
-            return -1;
+            if (!statis.statuses[code].latency)
+                continue;
+
+            stats_merge(total.latency, statis.statuses[code].latency);
+            stats_merge(total.size, statis.statuses[code].size);
         }
-    }
 
-    flags = 1;
-#ifdef _WIN32
-    char enable = flags ? 1 : 0;
-    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
-#else
-    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flags, sizeof(flags));
-#endif
-        
-    std::unique_ptr<connection> conn = std::make_unique<connection>();
-    conn->request = makeRequest(thread->cfg);
-    conn->fd = fd;
-    
-    FD_SET(fd, &thread->fds);
+        if (!total.size->count)
+            continue;
 
-    thread->fd.push_back(fd);
-    thread->conns.insert({ fd, std::move(conn) });
+        stats_correct(total.latency, interval);
+        printStatus(std::to_string(group) + "xx", total);
 
-    if (fd > thread->max)
-        thread->max = fd;
-        
-    return fd;
+        for (int code : top)
+        {
+            if (code / 100 != group)
+                continue;
+
+            stats_correct(statis.statuses[code].latency, interval);
+            printStatus("  " + std::to_string(code), statis.statuses[code]);
+        }
+    }
 }
 
-int socketReconnect(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
-{   
-    thread->fd.erase(std::remove(thread->fd.begin(), thread->fd.end(), conn->fd), thread->fd.end());
-    FD_CLR(conn->fd, &thread->fds);
-    
-    thread->conns.erase(conn->fd);
-    
-    conn.reset();
+void printStats(std::string name, std::unique_ptr<stats>& stats, std::string(*normalize)(long double, int))
+{
+    uint64_t max = stats->max;
+    long double mean = stats_mean(stats);
+    long double stdev = stats_stdev(stats, mean);
 
-    return socketConnect(thread);
+    printf("    %-10s", name.c_str());
+    printUnits(mean, normalize, 8);
+    printUnits(stdev, normalize, 10);
+    printUnits(max, normalize, 9);
+    printf("%8.2Lf%%\n", stats_within_stdev(stats, mean, stdev, 1));
 }
 
-void socketCheck(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+// Where the time went, not corrected for coordinated omission: a late start shows up in Send
+void printTiming(statistics& statis)
 {
-    switch (sock.connect(conn, thread->cfg.url.host))
-    {
-    case OK:    
-        break;
-    case ERR:
-        socketErrorConnect(thread->errors.connect);
-        socketReconnect(thread, conn);
-        return;        
-    case RETRY: 
-        return;
-        break;
+    printf("  Phase%12s%9s%9s%9s%9s\n", "Count", "Avg", "p50", "p99", "Max");
+
+    for (int i = 0; i < TIMINGS; ++i)
+    {
+        std::unique_ptr<stats>& phase = statis.timing.phase[i];
+
+        // Requests written and answers read whole in one batch have no send or transfer to show
+        if (!phase->count || !phase->max)
+            continue;
+
+        printf("  %-9s", timingNames[i]);
+        printUnits(phase->count, formatMetric, 9);
+        printUnits(stats_mean(phase), formatTime_us, 9);
+        printUnits(stats_percentile(phase, 50.0), formatTime_us, 9);
+        printUnits(stats_percentile(phase, 99.0), formatTime_us, 9);
+        printUnits(phase->max, formatTime_us, 9);
+        printf("\n");
     }
+}
 
-    conn->phase = WRITE;
+// The targets side by side, measured under the same client: each one's own latency, corrected for
+// its own expected interval when the run's is
+void printTargets(const config& cfg, results& result, bool correct)
+{
+    long double runtime = std::max<uint64_t>(1, result.runtime_us);
 
-    socketWrite(thread, conn);
+    printf("  Target%7s%9s%9s%9s%9s%9s%9s%8s  %s\n", "Conns", "Count", "Rate", "Avg", "p50", "p99", "Max", "Errors", "URL");
+
+    for (size_t i = 0; i < result.targets.size(); ++i)
+    {
+        endpointStats& target = result.targets[i];
+
+        if (correct && target.connections && target.complete / target.connections > 0)
+            stats_correct(target.latency, static_cast<int64_t>(result.runtime_us / (target.complete / target.connections)));
+
+        printf("  %-6zu%7llu", i + 1, (unsigned long long)target.connections);
+        printUnits(target.complete, formatMetric, 9);
+        printUnits(target.complete * 1000000 / runtime, formatMetric, 9);
+        printUnits(stats_mean(target.latency), formatTime_us, 9);
+        printUnits(stats_percentile(target.latency, 50.0), formatTime_us, 9);
+        printUnits(stats_percentile(target.latency, 99.0), formatTime_us, 9);
+        printUnits(target.latency->max, formatTime_us, 9);
+        printf("%8llu  %s\n", (unsigned long long)errorsTotal(target.errors), cfg.targets[i].name.c_str());
+    }
 }
 
-void socketWrite(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
+// Concurrency the users reached: by Little's law the time spent waiting for answers over the run
+// is how many were busy on average, the rest were thinking or reconnecting
+void printUsers(const config& cfg, results& result, uint64_t busy_us)
 {
-    if (!conn->written)
+    long double runtime = std::max<uint64_t>(1, result.runtime_us);
+    long double busy = busy_us / runtime;
+    long double thinking = result.thought_us / runtime;
+
+    printf("  Users: %llu, on average %.2Lf waiting for an answer and %.2Lf thinking", (unsigned long long)cfg.connections, busy, thinking);
+
+    if (cfg.think.kind != ThinkKind::NONE)
+        printf(", think %s mean %s", cfg.think.text.c_str(), formatTime_us(thinkMean_us(cfg.think)).c_str());
+
+    printf("\n");
+}
+
+// Streams opened and lost, then where the time of an event goes: the gap is the server's pace,
+// delivery its own latency as long as both clocks agree
+void printStream(const config& cfg, results& result)
+{
+    const streamCounters& stream = result.stream;
+    statistics& statis = result.statis;
+
+    printf("  Streams: %llu opened, %llu ended by the server\n", (unsigned long long)stream.opened, (unsigned long long)stream.ended);
+
+    if (stream.unstamped)
+        printf("  Events without %s: %llu\n", cfg.eventStamp.field.c_str(), (unsigned long long)stream.unstamped);
+
+    if (stream.ahead)
+        printf("  Events stamped after they arrived: %llu, the clocks disagree\n", (unsigned long long)stream.ahead);
+
+    if (!result.complete)
+        return;
+
+    printf("  Event%12s%9s%9s%9s%9s%9s\n", "Count", "Avg", "p50", "p99", "p99.9", "Max");
+
+    std::pair<const char*, std::unique_ptr<stats>*> rows[] = { { "Gap", &statis.latency }, { "Delivery", &statis.delivery } };
+
+    for (auto& row : rows)
     {
-        conn->data.clear();
-        conn->data.insert(conn->data.begin(), conn->request.begin(), conn->request.end());   
-    
-        conn->start = timeNow();
-        conn->pending = thread->cfg.pipeline;
+        std::unique_ptr<stats>& s = *row.second;
+        if (!s->count)
+            continue;
+
+        printf("  %-9s", row.first);
+        printUnits(s->count, formatMetric, 9);
+        printUnits(stats_mean(s), formatTime_us, 9);
+        printUnits(stats_percentile(s, 50.0), formatTime_us, 9);
+        printUnits(stats_percentile(s, 99.0), formatTime_us, 9);
+        printUnits(stats_percentile(s, 99.9), formatTime_us, 9);
+        printUnits(s->max, formatTime_us, 9);
+        printf("\n");
     }
+}
 
-    size_t n;
-    switch (sock.write(conn, n)) 
+// How much of the log was replayed, and how far behind its timing the requests went out
+void printReplay(const config& cfg, std::vector<std::unique_ptr<threadData>>& threadsData)
+{
+    uint64_t taken = 0, skipped = 0, late = 0, lagMax = 0;
+    bool ended = true;
+
+    for (auto& t : threadsData)
     {
-    case OK:    
-        break;
-    case ERR: 
-        thread->errors.write++;
-        socketReconnect(thread, conn);
-        return;
-        break;
-    case RETRY: 
-        return;
+        taken += t->replay.taken;
+        skipped += t->replay.skipped;
+        late += t->replay.late;
+        lagMax = std::max(lagMax, t->replay.lagMax);
+        ended = ended && t->replay.ended && !t->replay.count;
     }
-    
-    conn->written += conn->data.size();
-    thread->sent += conn->written;
-    conn->data.clear();
 
-    conn->phase = READ;
+    printf("  Replayed %llu requests of %s at %sx%s\n", (unsigned long long)taken, cfg.replayFile.c_str(),
+        formatMetric(cfg.speedup).c_str(), ended ? "" : ", stopped by -d before the end of the log");
 
-    socketRead(thread, conn);
-}
+    if (skipped)
+        printf("  Skipped %llu lines that are not requests\n", (unsigned long long)skipped);
 
-void socketRead(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
-{    
-    size_t n;
-    switch (sock.read(conn, n)) 
+    if (late)
     {
-    case OK:    
-        break;
-    case ERR: 
-        thread->errors.read++;
-        socketReconnect(thread, conn);
-        return;
-    case RETRY: 
-        return;            
+        printf("  Sent late: %llu requests %s or more after they were due, up to %s (too few connections)\n",
+            (unsigned long long)late, formatTime_us(REPLAY_LATE_US, 0).c_str(), formatTime_us(lagMax).c_str());
     }
+}
 
-    // MORE DATA INCOMING
-    if (!getContentLength(conn->data, conn->headersize)) 
-        return;
-            
-    setResults(thread, conn);
+// Percentiles of the gap between back to back empty polls, across all threads
+// Latency by mrk's clock and by the kernel's timestamps of the same answers, the gap is the
+// client's own share: scheduling, the event loop, the syscalls and parsing
+void printStamps(results& result)
+{
+    statistics& statis = result.statis;
+
+    if (statis.stamped[STAMP_KERNEL]->count)
+    {
+        printf("  Timed by%9s%9s%9s%9s%9s%9s%9s\n", "Count", "Avg", "p50", "p90", "p99", "p99.9", "Max");
 
-    thread->bytes += conn->data.size();
-    conn->written = 0;
+        for (int i = 0; i < STAMPS; ++i)
+        {
+            std::unique_ptr<stats>& s = statis.stamped[i];
+
+            printf("  %-9s", stampNames[i]);
+            printUnits(s->count, formatMetric, 8);
+            printUnits(stats_mean(s), formatTime_us, 9);
+            for (long double p : { 50.0L, 90.0L, 99.0L, 99.9L })
+                printUnits(stats_percentile(s, p), formatTime_us, 9);
+            printUnits(s->max, formatTime_us, 9);
+            printf("\n");
+        }
+    }
 
-    conn->phase = CONNECT;
+    if (result.unstamped)
+        printf("  Answers without kernel timestamps: %llu\n", (unsigned long long)result.unstamped);
+
+    if (result.kernelTimeDenied)
+        printf("  SO_TIMESTAMPING was refused on some sockets, their answers have no kernel timestamps\n");
 }
 
-void socketErrorConnect(uint32_t& connect)
+void printNoise(std::vector<std::unique_ptr<threadData>>& threadsData)
 {
-    connect++;
-}
+    std::unique_ptr<stats> noise = std::make_unique<stats>();
+    statsInit(noise, NOISE_LIMIT_NS / NOISE_RESOLUTION_NS);
 
-void setResults(std::unique_ptr<threadData>& thread, std::unique_ptr<connection>& conn)
-{   
-    int status = extractStatusCode(conn->data);
+    uint64_t max = 0;
+    bool denied = false;
 
-    if (status < 0)
+    for (auto& t : threadsData)
     {
-        thread->errors.status++;
+        stats_merge(noise, t->noise);
+        max = std::max(max, t->noiseMax);
+        denied |= t->busyPollDenied;
+    }
+
+    if (!noise->count)
+    {
+        printf("  Noise floor: no idle polls, the client never waited\n");
     }
     else
     {
-        thread->complete++;
-        thread->requests++;
-
-        if (status > 399)
-            thread->errors.status++;
-
-        if (!stats_record(statis.latency, getTime_us(conn->start)))
+        printf("  Noise floor: ");
+        for (long double p : { 50.0L, 99.0L, 99.9L })
         {
-            thread->errors.timeout++;
+            long double us = stats_percentile(noise, p) * NOISE_RESOLUTION_NS / 1000.0;
+            printf("p%g %s, ", (double)p, formatTime_us(us).c_str());
         }
+        printf("max %s (idle poll gaps)\n", formatTime_us(max / 1000.0).c_str());
     }
 
-    conn->written = 0;
-    conn->phase = WRITE;
+    if (denied)
+        printf("  SO_BUSY_POLL not permitted (needs CAP_NET_ADMIN), ignored\n");
 }
 
-std::string makeRequest(const config cfg, bool full)
+void printClientStats(std::vector<std::unique_ptr<threadData>>& threadsData)
 {
-    std::string request; 
+    printf("  Client Stats%9s%13s%14s%9s%9s%8s%8s\n", "Loops", "Events/Wake", "Syscalls/Req", "EAGAIN", "Partial", "Busy", "CPU");
 
-    request += "GET " + cfg.url.uri + " HTTP/1.1\r\n";
-    request += "Host: " + cfg.url.host;
+    std::vector<uint64_t> bound;
+    uint64_t id = 0;
 
-    if (!cfg.url.port.empty())
-        request += ":" + cfg.url.port;
-    
-    request += "\r\n";
+    for (auto& t : threadsData)
+    {
+        clientStats& c = t->client;
+        id++;
+
+        long double events = c.wakeups ? c.events / (long double)c.wakeups : 0.0;
+        long double syscalls = t->complete ? c.syscalls / (long double)t->complete : 0.0;
+        long double busy = c.wall_us ? 100.0 * (c.wall_us - std::min(c.wait_us, c.wall_us)) / c.wall_us : 0.0;
+        long double cpu = c.wall_us ? 100.0 * c.cpu_us / c.wall_us : 0.0;
+
+        printf("    Thread %-4llu", (unsigned long long)id);
+        printUnits(c.iterations, formatMetric, 8);
+        printf("%13.2Lf%14.2Lf", events, syscalls);
+        printUnits(c.again, formatMetric, 9);
+        printUnits(c.partial, formatMetric, 9);
+        printf("%7.1Lf%%%7.1Lf%%\n", busy, cpu);
+
+        if (busy >= CLIENT_BOUND_PCT || cpu >= CLIENT_BOUND_PCT)
+            bound.push_back(id);
+    }
 
-    if(full)
+    printf("  Clock source: %s, %.2fns per read, poller %s\n", clockName().c_str(), clk.overhead_ns, pollName());
+
+    if (!bound.empty())
     {
-        request += "User-Agent: mrk a HTTP benchmarking tool\r\n";
-        request += "Connection: keep-alive\r\n";
+        printf("  Warning: %llu of %llu threads were saturated, the result is client-bound\n",
+            (unsigned long long)bound.size(), (unsigned long long)threadsData.size());
     }
-        
-    return request + "\r\n";
 }
 
-void printStats(std::string name, std::unique_ptr<stats>& stats, std::string(*normalize)(long double, int))
+// Cost of the client per request, from each worker's counters: a cheaper hot path shows up here
+// before it shows up in the latency
+void printPerf(std::vector<std::unique_ptr<threadData>>& threadsData)
 {
-    uint64_t max = stats->max;
-    long double mean = stats_mean(stats);
-    long double stdev = stats_stdev(stats, mean);
+    const perfGroup* any = nullptr;
+    for (auto& t : threadsData)
+        if (t->perf.valid[PERF_CYCLES] || t->perf.valid[PERF_CONTEXT_SWITCHES])
+            any = &t->perf;
 
-    printf("    %-10s", name.c_str());
-    printUnits(mean, normalize, 8);
-    printUnits(stdev, normalize, 10);
-    printUnits(max, normalize, 9);
-    printf("%8.2Lf%%\n", stats_within_stdev(stats, mean, stdev, 1));
+    if (!any)
+    {
+        int error = threadsData.empty() ? 0 : threadsData[0]->perf.error;
+        printf("  Perf counters not available: %s, see /proc/sys/kernel/perf_event_paranoid\n", strerror(error));
+        return;
+    }
+
+    printf("  Perf Stats%13s%11s%7s%13s%13s%12s\n", "Cycles/Req", "Instr/Req", "IPC", "Cache/Req", "Branch/Req", "Ctx sw/Req");
+
+    uint64_t id = 0;
+
+    for (auto& t : threadsData)
+    {
+        const perfGroup& g = t->perf;
+        long double requests = std::max<uint64_t>(t->complete, 1);
+        id++;
+
+        printf("    Thread %-4llu", (unsigned long long)id);
+
+        for (int i = 0; i < PERF_COUNTERS; ++i)
+        {
+            int width = i == PERF_CYCLES ? 10 : i == PERF_INSTRUCTIONS ? 11 : i == PERF_CONTEXT_SWITCHES ? 12 : 13;
+
+            if (i == PERF_CACHE_MISSES)
+            {
+                // Instructions per cycle sits between the two it comes from
+                if (g.valid[PERF_CYCLES] && g.valid[PERF_INSTRUCTIONS] && g.values[PERF_CYCLES])
+                    printf("%7.2Lf", g.values[PERF_INSTRUCTIONS] / static_cast<long double>(g.values[PERF_CYCLES]));
+                else
+                    printf("%7s", "-");
+            }
+
+            if (g.valid[i])
+                printf("%*.*Lf", width, i == PERF_CYCLES || i == PERF_INSTRUCTIONS ? 0 : 3, g.values[i] / requests);
+            else
+                printf("%*s", width, "-");
+        }
+
+        printf("\n");
+    }
+
+    if (any->userOnly)
+        printf("  Counted in user space only, perf_event_paranoid keeps the syscalls out\n");
+
+    if (any->error == ENOENT || any->error == ENODEV || any->error == EOPNOTSUPP)
+        printf("  No hardware counters on this machine, virtual machines often have none\n");
+    else if (any->error)
+        printf("  Some counters not available: %s\n", strerror(any->error));
 }
 
 void printUnits(long double n, std::string(*normalize)(long double, int), int width, int p)
@@ -434,12 +840,15 @@ void printUnits(long double n, std::string(*normalize)(long double, int), int wi
 
 bool parseArgs(config* cfg, std::string& url, std::string& headers, int argc, char** argv)
 {
+    std::vector<uint64_t> weights;
+    bool connections = false;
+
     int opt = 1;
     for (; opt < argc; ++opt)
     {
         char c;
         std::string arg;
-        if(!parseArg(argv[opt], c, arg)) break;
+        if(!parseArg(opt, argc, argv, c, arg)) break;
 
         switch (c) 
         {
@@ -448,9 +857,144 @@ bool parseArgs(config* cfg, std::string& url, std::string& headers, int argc, ch
             break;
         case 'c':
             if (scanMetric(arg, cfg->connections)) return false;
+            connections = true;
+            break;
+        case 'w':
+            if (scanMetrics(arg, weights)) return false;
+            break;
+        case 'U':
+            if (scanMetric(arg, cfg->users) || !cfg->users) return false;
+            break;
+        case 'j':
+            if (scanThink(arg, cfg->think)) return false;
             break;
         case 'd':
             if (scanTime(arg, cfg->duration)) return false;
+            cfg->capped = true;
+            break;
+        case 'T':
+            if (scanTime_ms(arg, cfg->timeout) || !cfg->timeout) return false;
+            break;
+        case 'C':
+            cfg->clientStats = true;
+            break;
+        case 'G':
+            cfg->perfCounters = true;
+            break;
+        case 'K':
+            if (arg != "tsc" && arg != "mono") return false;
+            cfg->tsc = arg == "tsc";
+            break;
+        case 'B':
+            cfg->busyPoll = true;
+            break;
+        case 'P':
+            if (scanMetric(arg, cfg->busyPollUs)) return false;
+            break;
+        case 'p':
+            if (scanList(arg, cfg->cpus) || cfg->cpus.empty()) return false;
+            break;
+        case 'k':
+            cfg->kernelTime = true;
+            break;
+        case 'I':
+            if (scanTime_ms(arg, cfg->interval) || cfg->interval < RECORD_INTERVAL_MS) return false;
+            break;
+        case 'l':
+            cfg->intervalLog = arg;
+            break;
+        case 'M':
+            cfg->heatmap = true;
+            break;
+        case 'z':
+            if (scanSLO(arg, cfg->search)) return false;
+            break;
+        case 'Y':
+            if (scanTime(arg, cfg->step) || !cfg->step) return false;
+            break;
+        case 'o':
+            cfg->saveFile = arg;
+            break;
+        case 'r':
+            cfg->compareFile = arg;
+            break;
+        case 'q':
+            if (scanThresholds(arg, cfg->thresholds)) return false;
+            break;
+        case 'R':
+            cfg->replayFile = arg;
+            break;
+        case 'x':
+        {
+            char* end = nullptr;
+            cfg->speedup = strtold(arg.c_str(), &end);
+            if (*end || !(cfg->speedup > 0)) return false;
+            break;
+        }
+        case 'E':
+            cfg->stream = true;
+            break;
+        case 'e':
+            if (scanEventTime(arg, cfg->eventStamp)) return false;
+            cfg->stamped = true;
+            break;
+        case 'H':
+            cfg->host = arg;
+            break;
+        case 's':
+            cfg->scenarioFile = arg;
+            break;
+        case 'N':
+            if (scanMetric(arg, cfg->pipeline) || !cfg->pipeline) return false;
+            break;
+        case 'W':
+            if (scanMetric(arg, cfg->wsSize)) return false;
+            break;
+        case 'y':
+            if (scanHex(arg, cfg->payload)) return false;
+            break;
+        case 'f':
+            if (scanFraming(arg, cfg->framing)) return false;
+            break;
+        case 'm':
+            if (arg.empty() || !std::all_of(arg.begin(), arg.end(), [](char ch) { return ch >= 'A' && ch <= 'Z'; })) return false;
+            cfg->method = arg;
+            break;
+        case 'b':
+            cfg->bodyFile = arg;
+            break;
+        case 'D':
+            cfg->discard = true;
+            break;
+        case 'S':
+        {
+            std::vector<int> statuses;
+            if (scanStatus(arg, statuses)) return false;
+            for (int status : statuses)
+                cfg->validate.statuses.set(status);
+            cfg->validate.status = true;
+            break;
+        }
+        case 'L':
+            if (scanMetric(arg, cfg->validate.size)) return false;
+            cfg->validate.length = true;
+            break;
+        case 'F':
+            if (arg.empty()) return false;
+            cfg->validate.substring = arg;
+            break;
+        case 'X':
+            if (arg[0] == '@')
+            {
+                cfg->validate.hashFile = arg.substr(1);
+            }
+            else
+            {
+                char* end = nullptr;
+                cfg->validate.reference = strtoull(arg.c_str(), &end, 16);
+                if (arg.empty() || arg.size() > 18 || *end) return false;
+            }
+            cfg->validate.hash = true;
             break;
         case 'v':
             printf("mrk %s\n", version().c_str());
@@ -467,38 +1011,107 @@ bool parseArgs(config* cfg, std::string& url, std::string& headers, int argc, ch
 
     if (opt == argc || !cfg->threads || !cfg->duration) return false;
 
+    // Every user holds its own keep-alive connection, their number is the connection count
+    if (cfg->users)
+    {
+        if (connections)
+        {
+            std::cout << "--users sets the connections, drop -c" << std::endl;
+            return false;
+        }
+
+        if (cfg->users < cfg->threads)
+        {
+            std::cout << "number of users must be >= threads" << std::endl;
+            return false;
+        }
+
+        cfg->connections = cfg->users;
+    }
+
     if (!cfg->connections || cfg->connections < cfg->threads) 
     {
         std::cout << "number of connections must be >= threads" << std::endl;
         return false;
     }
 
-    url = argv[opt];
+    // Every URL left is a target, connections are dealt to them by weight
+    for (; opt < argc; ++opt)
+    {
+        cfg->targets.push_back({ argv[opt], parseURL(argv[opt]) });
+        url += (url.empty() ? "" : ", ") + std::string(argv[opt]);
+    }
+
+    if (!weights.empty())
+    {
+        if (weights.size() != cfg->targets.size())
+        {
+            std::cout << "--weights takes one weight per URL" << std::endl;
+            return false;
+        }
+
+        for (size_t i = 0; i < weights.size(); ++i)
+            cfg->targets[i].weight = weights[i];
+    }
 
     return true;
 }
 
-bool parseArg(std::string arg, char& c, std::string& out)
+bool parseArg(int& opt, int argc, char** argv, char& c, std::string& out)
 {
+    std::string arg = argv[opt];
+
     if (arg[0] != '-' || arg.size() < 2)
         return false;
 
-    if (arg[1] == 't')
-        c = 't';
-    else if (arg[1] == 'c')
-        c = 'c';
-    else if (arg[1] == 'd')
-        c = 'd';
-    else if (arg[1] == 'v')
-        c = 'v';
-    else if (arg[1] == 'h')
-        c = 'h';
-    else if (arg[1] == '?')
+    const argOption* option = nullptr;
+    bool attached = false;
+
+    if (arg[1] == '-')
+    {
+        // --name value or --name=value
+        std::string name = arg.substr(2);
+        size_t eq = name.find('=');
+        if (eq != std::string::npos)
+        {
+            out = name.substr(eq + 1);
+            name = name.substr(0, eq);
+            attached = true;
+        }
+
+        for (const auto& o : options)
+            if (o.name == name)
+                option = &o;
+    }
+    else
+    {
+        // -xvalue or -x value
+        for (const auto& o : options)
+            if (o.c == arg[1])
+                option = &o;
+
+        out = arg.substr(2);
+        attached = !out.empty();
+    }
+
+    if (!option)
+    {
         c = '?';
-    else    
-        return false;
+        return true;
+    }
 
-    out = arg.substr(2);
+    c = option->c;
+
+    if (option->argument && !attached)
+    {
+        if (opt + 1 >= argc)
+        {
+            c = '?';
+            return true;
+        }
+
+        out = argv[++opt];
+    }
     
     return true;
 }
@@ -1,37 +1,34 @@
 #pragma once
 
-#include <mutex>
+#include "engine.hpp"
 
-#include "common.hpp"
-#include "net.hpp"
+struct argOption
+{
+    std::string name;
+    bool argument;
+    char c;
+};
 
-sockFuncions sock;
-statistics statis;
-
-std::mutex _mutex;
-
-std::atomic<bool> isRunning;
-
-std::vector<std::thread> threads;
-
-void threadMain(uint64_t, std::unique_ptr<threadData>&);
-
-int socketConnect(std::unique_ptr<threadData>&);
-int socketReconnect(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
-void socketCheck(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
-void socketWrite(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
-void socketRead(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
-
-void socketErrorConnect(uint32_t&);
-
-void setResults(std::unique_ptr<threadData>&, std::unique_ptr<connection>&);
-
-std::string makeRequest(const config, bool = false);
+bool waitUntil(std::chrono::high_resolution_clock::time_point, engine&);
+void searchRun(engine&);
+void intervalCollect(timeline&, engine&, baseline*, uint64_t);
 
 void printStats(std::string, std::unique_ptr<stats>&, std::string(*normalize)(long double, int));
+void printStatus(std::string, statusStats&);
+void printStatuses(const config&, statistics&, int64_t);
+void printSteps(const config&, statistics&, int64_t, const std::vector<uint64_t>&);
+void printReplay(const config&, std::vector<std::unique_ptr<threadData>>&);
+void printTiming(statistics&);
+void printTargets(const config&, results&, bool);
+void printUsers(const config&, results&, uint64_t);
+void printStream(const config&, results&);
+void printStamps(results&);
+void printNoise(std::vector<std::unique_ptr<threadData>>&);
+void printPerf(std::vector<std::unique_ptr<threadData>>&);
+void printClientStats(std::vector<std::unique_ptr<threadData>>&);
 void printUnits(long double, std::string(*normalize)(long double, int), int, int = 2);
 
 bool parseArgs(config*, std::string&, std::string&, int, char**);
-bool parseArg(std::string, char&, std::string&);
+bool parseArg(int&, int, char**, char&, std::string&);
 
 std::string version();
\ No newline at end of file
@@ -1,8 +1,36 @@
 
 #include "net.hpp"
 
+#include <cstddef>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#endif
+
+thread_local clientStats client = {};
+
 status sockConnect(std::unique_ptr<connection>& conn, const std::string& host) 
 {
+    // Writable after a non-blocking connect, check whether it succeeded
+    int err = 0;
+    socklen_t len = sizeof(err);
+    client.syscalls++;
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, (char*)&err, &len) == -1)
+        return ERR;
+
+    if (err)
+    {
+        // Leave the cause where sockRefused looks for it
+#ifdef _WIN32
+        WSASetLastError(err);
+#else
+        errno = err;
+#endif
+        return ERR;
+    }
+
     return OK;
 }
 
@@ -18,9 +46,68 @@ size_t sockReadable(std::unique_ptr<connection>& conn)
 #endif
 }
 
+// Sends the next part of header + body starting at conn->written, n is what went out
 status sockWrite(std::unique_ptr<connection>& conn, size_t& n)
 {       
-    ssize_t r = send(conn->fd, conn->data.data(), conn->data.size(), 0);    
+    const requestBody* body = conn->payload;
+    size_t header = conn->request.size();
+    size_t size = body ? body->size : 0;
+    size_t offset = conn->written > header ? conn->written - header : 0;
+    size_t remaining = header + size - conn->written;
+    ssize_t r;
+
+#ifdef _WIN32
+    WSABUF bufs[2];
+    DWORD count = 0, sent = 0;
+
+    if (conn->written < header)
+    {
+        bufs[count].buf = const_cast<char*>(conn->request.data() + conn->written);
+        bufs[count++].len = static_cast<ULONG>(header - conn->written);
+    }
+    if (size)
+    {
+        bufs[count].buf = const_cast<char*>(body->data + offset);
+        bufs[count++].len = static_cast<ULONG>(size - offset);
+    }
+
+    r = WSASend(conn->fd, bufs, count, &sent, 0, NULL, NULL) == 0 ? static_cast<ssize_t>(sent) : -1;
+#else
+    // Prebuilt rounds live in memory, only file bodies can be sent from the page cache
+    bool gather = size <= SENDFILE_MIN || body->fd == -1;
+
+    if (conn->written < header || gather)
+    {
+        // Header block, and small bodies, in one gathered write straight from the shared buffers
+        iovec iov[2];
+        int count = 0;
+
+        if (conn->written < header)
+        {
+            iov[count].iov_base = const_cast<char*>(conn->request.data() + conn->written);
+            iov[count++].iov_len = header - conn->written;
+        }
+        if (size && gather)
+        {
+            iov[count].iov_base = const_cast<char*>(body->data + offset);
+            iov[count++].iov_len = size - offset;
+        }
+
+        r = writev(conn->fd, iov, count);
+    }
+    else
+    {
+#ifdef __linux__
+        // Large bodies go from the page cache to the socket without touching user space
+        off_t position = offset;
+        r = sendfile(conn->fd, body->fd, &position, size - offset);
+#else
+        r = send(conn->fd, body->data + offset, size - offset, 0);
+#endif
+    }
+#endif
+    client.syscalls++;
+
     if (r <= 0)
     {
 #ifdef _WIN32 
@@ -28,46 +115,210 @@ status sockWrite(std::unique_ptr<connection>& conn, size_t& n)
 #else 
         if (errno == EAGAIN || errno == EWOULDBLOCK)
 #endif	   
+        {
+            client.again++;
             return RETRY;
+        }
         
         return ERR;        
     }
+
+    if ((size_t)r < remaining)
+        client.partial++;
         
     n = r;
 
     return OK;
 }
 
-status sockRead(std::unique_ptr<connection>& conn, size_t& n)
+status sockResult(ssize_t r, size_t& n)
 {
-    std::vector<char> chunk;
-    while(true)
+    if (r >= 0)
     {
-        chunk.resize(RECVBUF);
-        ssize_t r = recv(conn->fd, chunk.data(), chunk.size(), 0);
-        if (r > 0)
-        {
-            conn->data.insert(conn->data.end(), chunk.begin(), chunk.begin() + r);
-            chunk.clear();
+        n = r;
+        return OK;
+    }
 
-            n += r;
-        }
-        else
-        {
-            if (conn->data.size() > 0)
-                break;
 #ifdef _WIN32 
-            if (WSAGetLastError() == WSAEWOULDBLOCK)
+    if (WSAGetLastError() == WSAEWOULDBLOCK)
 #else 
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
 #endif	   
-                return RETRY;
+    {
+        client.again++;
+        return RETRY;
+    }
+
+    return ERR;
+}
+
+// One recv into the caller's buffer, n is 0 once the peer closed
+status sockRead(std::unique_ptr<connection>& conn, char* data, size_t size, size_t& n)
+{
+    ssize_t r = recv(conn->fd, data, static_cast<int>(size), 0);
+    client.syscalls++;
+
+    return sockResult(r, n);
+}
+
+#ifdef __linux__
+// Software timestamps, which every device and loopback have: transmit ones on the error queue,
+// receive ones with the data
+bool sockStamping(socket_t fd)
+{
+    int flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_OPT_TSONLY;
+
+    return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+}
+
+// The software timestamp of a message, us of CLOCK_REALTIME, 0 without one
+uint64_t stampOf(msghdr& msg)
+{
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING)
+            continue;
+
+        const scm_timestamping* stamps = reinterpret_cast<const scm_timestamping*>(CMSG_DATA(cmsg));
+        return stamps->ts[0].tv_sec * 1000000ULL + stamps->ts[0].tv_nsec / 1000;
+    }
+
+    return 0;
+}
+
+// sockRead for --kernel-time, keeps when the kernel received the last segment read
+status sockReadStamped(std::unique_ptr<connection>& conn, char* data, size_t size, size_t& n)
+{
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping))];
+    iovec iov = { data, size };
+
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
 
-            return ERR;
+    ssize_t r = recvmsg(conn->fd, &msg, 0);
+    client.syscalls++;
+
+    if (r > 0)
+    {
+        uint64_t stamp = stampOf(msg);
+        if (stamp)
+            conn->kernelRead = stamp;
+    }
+
+    return sockResult(r, n);
+}
+
+// Empties the error queue, conn->kernelSent keeps the latest transmit timestamp: the last
+// segment of the round
+void sockSentStamps(std::unique_ptr<connection>& conn)
+{
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(sock_extended_err))];
+
+    while (true)
+    {
+        msghdr msg = {};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t r = recvmsg(conn->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+        client.syscalls++;
+
+        if (r < 0)
+            break;
+
+        conn->kernelSent = std::max(conn->kernelSent, stampOf(msg));
+    }
+}
+#endif
+
+// Drops up to size bytes of the receive queue, on Linux without copying them to user space
+status sockDiscard(std::unique_ptr<connection>& conn, size_t size, size_t& n)
+{
+#ifdef __linux__
+    if (conn->truncate)
+    {
+        ssize_t r = recv(conn->fd, nullptr, size, MSG_TRUNC);
+        client.syscalls++;
+
+        if (r >= 0 || (errno != EINVAL && errno != EOPNOTSUPP && errno != EFAULT))
+            return sockResult(r, n);
+
+        // Not every socket type takes MSG_TRUNC, copy out and throw away instead. Only this
+        // connection: the other targets of the thread may well take it
+        conn->truncate = false;
+    }
+#endif
+
+    static thread_local std::vector<char> sink(RECV_SCRATCH);
+
+    return sockRead(conn, sink.data(), std::min<size_t>(size, sink.size()), n);
+}
+
+// Address of a target, looked up once for every connection it will get
+bool sockResolve(endpoint& target, std::string& error)
+{
+    target.addr = {};
+
+    if (!target.url.socket.empty())
+    {
+#ifdef _WIN32
+        error = "Cannot resolve " + target.name;
+        return false;
+#else
+        // Same engine, only the address differs: no DNS, no TCP stack
+        sockaddr_un* addr = reinterpret_cast<sockaddr_un*>(&target.addr);
+
+        // Cut short it would name another socket, and connect would fail with a misleading error
+        if (target.url.socket.size() >= sizeof(addr->sun_path))
+        {
+            error = "Unix socket path too long, at most " + std::to_string(sizeof(addr->sun_path) - 1) + " bytes: " + target.url.socket;
+            return false;
         }
+
+        addr->sun_family = AF_UNIX;
+        memcpy(addr->sun_path, target.url.socket.c_str(), target.url.socket.size() + 1);
+        target.addrlen = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + target.url.socket.size() + 1);
+
+        return true;
+#endif
     }
 
-    return OK;
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 0), &wsaData) != 0)
+        return false;
+#endif
+
+    addrinfo hints{}, * result = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char* end = nullptr;
+    unsigned long port = strtoul(target.url.port.c_str(), &end, 10);
+    bool found = !*end && port && port <= UINT16_MAX && getaddrinfo(target.url.host.c_str(), target.url.port.c_str(), &hints, &result) == 0;
+
+    if (found)
+    {
+        sockaddr_in* addr = reinterpret_cast<sockaddr_in*>(&target.addr);
+        addr->sin_family = AF_INET;
+        addr->sin_addr.s_addr = reinterpret_cast<sockaddr_in*>(result->ai_addr)->sin_addr.s_addr;
+        addr->sin_port = htons(static_cast<uint16_t>(port));
+        target.addrlen = sizeof(sockaddr_in);
+
+        freeaddrinfo(result);
+    }
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    if (!found)
+        error = "Cannot resolve " + target.name;
+
+    return found;
 }
 
 void sockClose(const socket_t& fd)
@@ -79,4 +330,24 @@ void sockClose(const socket_t& fd)
 #else
     close(fd);
 #endif	
+}
+
+// Cause of the last ERR, checked right after it
+bool sockRefused()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAECONNREFUSED;
+#else
+    return errno == ECONNREFUSED;
+#endif
+}
+
+bool sockReset()
+{
+#ifdef _WIN32
+    int err = WSAGetLastError();
+    return err == WSAECONNRESET || err == WSAECONNABORTED;
+#else
+    return errno == ECONNRESET || errno == EPIPE;
+#endif
 }
\ No newline at end of file
@@ -9,17 +9,40 @@ enum status
     RETRY
 };
 
-struct sockFuncions 
-{    
-    status(*connect)(std::unique_ptr<connection>&, const std::string&);
-    size_t(*readable)(std::unique_ptr<connection>&);
-    status(*write)(std::unique_ptr<connection>&, size_t&);
-    status(*read)(std::unique_ptr<connection>&, size_t&);
-    void(*close)(const socket_t&);
-};
+// Syscall and partial I/O counters of the calling worker
+extern thread_local clientStats client;
 
 status sockConnect(std::unique_ptr<connection>&, const std::string&);
 size_t sockReadable(std::unique_ptr<connection>&);
 status sockWrite(std::unique_ptr<connection>&, size_t&);
-status sockRead(std::unique_ptr<connection>&, size_t&);
-void sockClose(const socket_t&);
\ No newline at end of file
+status sockRead(std::unique_ptr<connection>&, char*, size_t, size_t&);
+status sockDiscard(std::unique_ptr<connection>&, size_t, size_t&);
+#ifdef __linux__
+bool sockStamping(socket_t);
+status sockReadStamped(std::unique_ptr<connection>&, char*, size_t, size_t&);
+void sockSentStamps(std::unique_ptr<connection>&);
+#endif
+void sockClose(const socket_t&);
+bool sockResolve(endpoint&, std::string&);
+
+bool sockRefused();
+bool sockReset();
+
+// Socket calls of a run, picked once: the event loop is instantiated for each policy, so every
+// call is direct and nothing is looked up per request
+struct plainSocket
+{
+    static status connect(std::unique_ptr<connection>& conn, const std::string& host) { return sockConnect(conn, host); }
+    static status write(std::unique_ptr<connection>& conn, size_t& n) { return sockWrite(conn, n); }
+    static status read(std::unique_ptr<connection>& conn, char* data, size_t size, size_t& n) { return sockRead(conn, data, size, n); }
+    static status discard(std::unique_ptr<connection>& conn, size_t size, size_t& n) { return sockDiscard(conn, size, n); }
+    static void close(const socket_t& fd) { sockClose(fd); }
+};
+
+#ifdef __linux__
+// --kernel-time: reads go through recvmsg for their receive timestamps
+struct stampedSocket : plainSocket
+{
+    static status read(std::unique_ptr<connection>& conn, char* data, size_t size, size_t& n) { return sockReadStamped(conn, data, size, n); }
+};
+#endif
\ No newline at end of file
@@ -1,17 +1,56 @@
 
 #include "parser.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+// tcp:// has no well known port, it is left empty
+std::string defaultPort(const std::string& schema)
+{
+    if (schema == "tcp")
+        return "";
+
+    return schema == "https" ? "443" : "80";
+}
+
+// unix:/path/to.sock[:/uri], ws+unix: and tcp+unix: run the other protocols over it
+bool parseUnixURL(const std::string& input, ParsedURL& parsedURL)
+{
+    size_t colon = input.find(':');
+    if (colon == std::string::npos)
+        return false;
+
+    std::string schema = input.substr(0, colon);
+    if (schema != "unix" && schema != "ws+unix" && schema != "tcp+unix")
+        return false;
+
+    std::string target = input.substr(colon + 1);
+    size_t uri = target.find(':');
+
+    parsedURL.schema = schema == "unix" ? "http" : schema.substr(0, schema.find('+'));
+    parsedURL.socket = target.substr(0, uri);
+    parsedURL.uri = uri == std::string::npos ? "/" : target.substr(uri + 1);
+    parsedURL.host = "localhost";
+
+    return true;
+}
+
 ParsedURL parseURL(const std::string& input)
 {
     std::string buffer;
     ParsedURL parsedURL;
+
+    if (parseUnixURL(input, parsedURL))
+        return parsedURL;
+
     ParseURLState state = ParseURLState::SCHEMA;
     for (char c : input)
     {
         switch (state)
         {
         case ParseURLState::SCHEMA:
-            if (c == ':' && (buffer == "http" || buffer == "https"))
+            if (c == ':' && (buffer == "http" || buffer == "https" || buffer == "ws" || buffer == "tcp"))
             {
                 parsedURL.schema = buffer;
                 buffer.clear();
@@ -67,7 +106,7 @@ ParsedURL parseURL(const std::string& input)
         case ParseURLState::PORT:
             if (c == '/')
             {
-                parsedURL.port = buffer.empty() ? (parsedURL.schema == "https" ? "443" : "80") : buffer;
+                parsedURL.port = buffer.empty() ? defaultPort(parsedURL.schema) : buffer;
                 buffer.clear();
                 state = ParseURLState::URI;
 
@@ -95,11 +134,11 @@ ParsedURL parseURL(const std::string& input)
     }
     if (state == ParseURLState::PORT)
     {
-        parsedURL.port = buffer.empty() ? (parsedURL.schema == "https" ? "443" : "80") : buffer;
+        parsedURL.port = buffer.empty() ? defaultPort(parsedURL.schema) : buffer;
     }
 
     if (parsedURL.port.empty())
-        parsedURL.port = parsedURL.schema == "https" ? "443" : "80";
+        parsedURL.port = defaultPort(parsedURL.schema);
 
     if (parsedURL.uri.empty())
         parsedURL.uri = "/";
@@ -107,65 +146,285 @@ ParsedURL parseURL(const std::string& input)
     return parsedURL;
 }
 
-int extractStatusCode(const std::vector<char>& response) 
+void responseReset(httpResponse& r)
+{
+    r.state = ResponseState::HEADER;
+    r.status = -1;
+    r.remaining = 0;
+    r.body = 0;
+    r.bytes = 0;
+    r.line = 0;
+    r.extension = false;
+    r.header.clear();
+}
+
+// Offset in data just past the \r\n\r\n closing the header block, npos when not there yet
+size_t headerEnd(const std::vector<char>& header, const char* data, size_t size)
+{
+    // Terminator split across two reads
+    size_t tail = std::min<size_t>(header.size(), 3);
+    size_t head = std::min<size_t>(size, 3);
+    char edge[6];
+
+    if (tail)
+        memcpy(edge, header.data() + header.size() - tail, tail);
+    memcpy(edge + tail, data, head);
+
+    for (size_t k = 0; k + 4 <= tail + head; ++k)
+    {
+        if (k + 4 > tail && memcmp(edge + k, "\r\n\r\n", 4) == 0)
+            return k + 4 - tail;
+    }
+
+    const char* end = data + size;
+    for (const char* p = data + 3; p < end; ++p)
+    {
+        p = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!p)
+            break;
+
+        if (p[-1] == '\r' && p[-2] == '\n' && p[-3] == '\r')
+            return p - data + 1;
+    }
+
+    return std::string::npos;
+}
+
+bool headerIs(const char* line, size_t size, const char* name)
+{
+    size_t length = strlen(name);
+    if (size < length)
+        return false;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (tolower(static_cast<unsigned char>(line[i])) != name[i])
+            return false;
+    }
+
+    return true;
+}
+
+// Status code and body framing from a complete header block
+void headerParse(httpResponse& r)
 {
-    ParseState state = ParseState::START;
-    std::string statusCodeStr;
+    const char* data = r.header.data();
+    const char* end = data + r.header.size();
+
+    bool chunked = false;
+    bool length = false;
+    uint64_t size = 0;
 
-    for (char c : response) 
+    const char* line = data;
+    while (line < end)
     {
-        switch (state) 
+        const char* eol = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!eol)
+            eol = end;
+
+        size_t n = eol - line;
+
+        if (line == data)
+        {
+            // HTTP/1.1 200 OK
+            const char* sp = static_cast<const char*>(memchr(line, ' ', n));
+            if (sp && eol - sp > 3 && isdigit(sp[1]) && isdigit(sp[2]) && isdigit(sp[3]))
+                r.status = (sp[1] - '0') * 100 + (sp[2] - '0') * 10 + (sp[3] - '0');
+        }
+        else if (headerIs(line, n, "content-length:"))
         {
-        case ParseState::START:
-            if (c == 'H') 
-                state = ParseState::HTTP;            
+            length = true;
+            size = strtoull(line + 15, nullptr, 10);
+        }
+        else if (headerIs(line, n, "transfer-encoding:"))
+        {
+            for (const char* p = line + 18; p + 7 <= eol; ++p)
+                if (headerIs(p, eol - p, "chunked"))
+                    chunked = true;
+        }
+
+        line = eol + 1;
+    }
+
+    if (r.status < 0)
+    {
+        r.state = ResponseState::FAILED;
+        return;
+    }
+
+    if (r.status == 101 && r.upgrade)
+    {
+        r.state = ResponseState::DONE;
+        return;
+    }
+
+    if (r.status >= 100 && r.status < 200)
+    {
+        // Interim response, the real one follows
+        r.header.clear();
+        r.status = -1;
+        return;
+    }
+
+    if (r.head || r.status == 204 || r.status == 304)
+        r.state = ResponseState::DONE;
+    else if (chunked)
+        r.state = ResponseState::CHUNK_SIZE;
+    else if (length)
+        r.state = size ? ResponseState::BODY : ResponseState::DONE;
+    else
+        r.state = ResponseState::UNTIL_CLOSE;
+
+    r.remaining = size;
+}
+
+// Feeds the next bytes of the stream, returns how many belong to this response
+size_t responseParse(httpResponse& r, const char* data, size_t size, bodyHandler handler, void* ctx)
+{
+    size_t i = 0;
+
+    while (i < size && r.state != ResponseState::DONE && r.state != ResponseState::FAILED)
+    {
+        switch (r.state)
+        {
+        case ResponseState::HEADER:
+        {
+            size_t end = headerEnd(r.header, data + i, size - i);
+            size_t n = end == std::string::npos ? size - i : end;
+
+            r.header.insert(r.header.end(), data + i, data + i + n);
+            i += n;
+
+            if (end != std::string::npos)
+                headerParse(r);
+            else if (r.header.size() > RESPONSE_HEADER_MAX)
+                r.state = ResponseState::FAILED;
             break;
+        }
+        case ResponseState::BODY:
+        case ResponseState::CHUNK_DATA:
+        {
+            uint64_t n = std::min<uint64_t>(r.remaining, size - i);
+
+            if (handler)
+                handler(ctx, data + i, n);
+
+            r.remaining -= n;
+            r.body += n;
+            i += n;
 
-        case ParseState::HTTP:
-            if (c == ' ') 
-                state = ParseState::STATUS_CODE;            
+            if (!r.remaining)
+                r.state = r.state == ResponseState::BODY ? ResponseState::DONE : ResponseState::CHUNK_END;
             break;
+        }
+        case ResponseState::CHUNK_SIZE:
+        {
+            // Hex size, optional ;extensions, CRLF
+            char c = data[i++];
+
+            if (c == '\n')
+            {
+                if (!r.line)
+                    r.state = ResponseState::FAILED;
+                else
+                    r.state = r.remaining ? ResponseState::CHUNK_DATA : ResponseState::TRAILER;
+
+                r.line = 0;
+                r.extension = false;
+            }
+            else if (!r.extension && isxdigit(static_cast<unsigned char>(c)))
+            {
+                r.remaining = r.remaining * 16 + (isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
 
-        case ParseState::STATUS_CODE:
-            if (c == ' ') 
-                state = ParseState::FINISH;
-            
-            else 
-                statusCodeStr += c;
+                // More than 64 bits of size
+                if (++r.line > 16)
+                    r.state = ResponseState::FAILED;
+            }
+            else if (c != '\r')
+                r.extension = true;
             break;
+        }
+        case ResponseState::CHUNK_END:
+        {
+            // CRLF closing the chunk data
+            char c = data[i++];
 
-        case ParseState::FINISH:            
+            if (c == '\n')
+                r.state = ResponseState::CHUNK_SIZE;
+            else if (c != '\r')
+                r.state = ResponseState::FAILED;
             break;
         }
-    }
 
-    try 
-    {
-        return std::stoi(statusCodeStr);
+        case ResponseState::TRAILER:
+        {
+            // Trailer lines until an empty one
+            char c = data[i++];
+
+            if (c == '\n')
+            {
+                if (!r.line)
+                    r.state = ResponseState::DONE;
+                r.line = 0;
+            }
+            else if (c != '\r')
+                r.line++;
+            break;
+        }
+        case ResponseState::UNTIL_CLOSE:
+            if (handler)
+                handler(ctx, data + i, size - i);
+
+            r.body += size - i;
+            i = size;
+            break;
+
+        case ResponseState::DONE:
+        case ResponseState::FAILED:
+            break;
+        }
     }
-    catch (const std::exception& e) {}
 
-    return -1; // Invalid status code
+    r.bytes += i;
+
+    return i;
 }
 
-bool getContentLength(const std::vector<char>& data, size_t& headersize)
+bool responseDone(const httpResponse& r)
 {
-    std::string response(data.begin(), data.end());
+    return r.state == ResponseState::DONE;
+}
 
-    if(!headersize)
-        headersize = response.find("\r\n\r\n") + 4; // Add Double line break size
+bool responseFailed(const httpResponse& r)
+{
+    return r.state == ResponseState::FAILED;
+}
 
-    size_t pos = response.find("Content-Length: ");
-    if (pos != std::string::npos)
+// Body bytes that can be dropped without looking at them
+uint64_t responseSkippable(const httpResponse& r)
+{
+    switch (r.state)
     {
-        // Extract the content length value
-        size_t valueStart = pos + strlen("Content-Length: ");
-        size_t valueEnd = response.find_first_of("\r\n", valueStart);
-        std::string contentlength = response.substr(valueStart, valueEnd - valueStart);
-
-        if (data.size() - headersize < std::stoi(contentlength))
-            return false;
+    case ResponseState::BODY:
+    case ResponseState::CHUNK_DATA:
+        return r.remaining;
+    case ResponseState::UNTIL_CLOSE:
+        return UINT64_MAX;
+    default:
+        return 0;
     }
+}
 
-    return true;
-}
\ No newline at end of file
+void responseSkip(httpResponse& r, uint64_t n)
+{
+    r.body += n;
+    r.bytes += n;
+
+    if (r.state == ResponseState::UNTIL_CLOSE)
+        return;
+
+    r.remaining -= n;
+
+    if (!r.remaining)
+        r.state = r.state == ResponseState::BODY ? ResponseState::DONE : ResponseState::CHUNK_END;
+}
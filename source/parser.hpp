@@ -3,13 +3,23 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstring>
+#include <cstdint>
 
-enum class ParseState 
+#define HTTP_STATUS_MAX      1000
+#define RESPONSE_HEADER_MAX  (64 * 1024)
+
+enum class ResponseState
 {
-    START,
-    HTTP,
-    STATUS_CODE,
-    FINISH
+    HEADER,
+    BODY,
+    CHUNK_SIZE,
+    CHUNK_DATA,
+    CHUNK_END,
+    TRAILER,
+    UNTIL_CLOSE,
+    DONE,
+    FAILED
 };
 
 enum class ParseURLState
@@ -27,8 +37,32 @@ struct ParsedURL
     std::string host;
     std::string port;
     std::string uri;
+    std::string socket;     // unix domain socket path, host and port are only used for Host then
+};
+
+// Incremental HTTP/1.1 response parser, only the header block is ever buffered
+struct httpResponse
+{
+    ResponseState state = ResponseState::HEADER;
+    int status = -1;
+    bool head = false;          // answer to a HEAD request, never has a body
+    bool upgrade = false;       // answer to an Upgrade request, 101 is final
+    uint64_t remaining = 0;     // bytes left in the body or the current chunk
+    uint64_t body = 0;
+    uint64_t bytes = 0;
+    size_t line = 0;            // bytes of the current chunk size or trailer line
+    bool extension = false;     // past the digits of a chunk size line
+    std::vector<char> header;
 };
 
+// Receives every body span as it is parsed, chunk framing already stripped
+typedef void(*bodyHandler)(void*, const char*, size_t);
+
 ParsedURL parseURL(const std::string&);
-int extractStatusCode(const std::vector<char>&);
-bool getContentLength(const std::vector<char>&, size_t&);
\ No newline at end of file
+
+void responseReset(httpResponse&);
+size_t responseParse(httpResponse&, const char*, size_t, bodyHandler = nullptr, void* = nullptr);
+bool responseDone(const httpResponse&);
+bool responseFailed(const httpResponse&);
+uint64_t responseSkippable(const httpResponse&);
+void responseSkip(httpResponse&, uint64_t);
\ No newline at end of file
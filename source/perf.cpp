@@ -0,0 +1,143 @@
+#include "perf.hpp"
+
+#include <cerrno>
+
+#ifdef __linux__
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+const char* perfNames[PERF_COUNTERS] = { "cycles", "instructions", "cache misses", "branch misses", "context switches" };
+
+#ifdef __linux__
+
+int perfEvent(perfCounter counter, int group, bool userOnly)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+
+    static const uint64_t hardware[] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+    if (counter == PERF_CONTEXT_SWITCHES)
+    {
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+    }
+    else
+    {
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = hardware[counter];
+    }
+
+    // The leader starts disabled, the others follow it
+    attr.disabled = group == -1;
+    attr.exclude_kernel = userOnly;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // This thread, on whichever CPU it runs
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+// Opens what the calling thread is allowed to count, false when nothing at all
+bool perfOpen(perfGroup& g)
+{
+    for (int attempt = 0; attempt < 2 && g.leader == -1; ++attempt)
+    {
+        // perf_event_paranoid 2 only lets a process count itself in user space
+        g.userOnly = attempt == 1;
+        g.error = 0;
+
+        for (int i = 0; i < PERF_COUNTERS; ++i)
+        {
+            int fd = perfEvent(static_cast<perfCounter>(i), g.leader, g.userOnly);
+
+            if (fd == -1)
+            {
+                if (!g.error)
+                    g.error = errno;
+
+                // Everything else would be refused the same way
+                if (errno == EACCES || errno == EPERM)
+                    break;
+
+                continue;
+            }
+
+            g.fds[i] = fd;
+            g.valid[i] = true;
+
+            if (g.leader == -1)
+                g.leader = fd;
+        }
+    }
+
+    return g.leader != -1;
+}
+
+void perfStart(perfGroup& g)
+{
+    if (g.leader == -1)
+        return;
+
+    ioctl(g.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(g.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+// Reads the group once and closes it, values are scaled to the whole time enabled
+void perfStop(perfGroup& g)
+{
+    if (g.leader == -1)
+        return;
+
+    ioctl(g.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // nr, time enabled, time running, then one value per member in the order they were opened
+    uint64_t data[3 + PERF_COUNTERS] = {};
+    ssize_t n = read(g.leader, data, sizeof(data));
+
+    if (n >= static_cast<ssize_t>(3 * sizeof(uint64_t)))
+    {
+        uint64_t members = data[0], enabled = data[1], running = data[2];
+        long double scale = running ? enabled / static_cast<long double>(running) : 0;
+
+        for (int i = 0, k = 0; i < PERF_COUNTERS && static_cast<uint64_t>(k) < members; ++i)
+        {
+            if (!g.valid[i])
+                continue;
+
+            g.values[i] = static_cast<uint64_t>(data[3 + k++] * scale);
+        }
+    }
+
+    for (int& fd : g.fds)
+    {
+        if (fd != -1)
+            close(fd);
+        fd = -1;
+    }
+
+    g.leader = -1;
+}
+
+#else
+
+bool perfOpen(perfGroup& g)
+{
+    g.error = ENOSYS;
+    return false;
+}
+
+void perfStart(perfGroup&)
+{
+}
+
+void perfStop(perfGroup&)
+{
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// What --perf-counters counts, in the order the group is opened
+enum perfCounter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    PERF_COUNTERS
+};
+
+extern const char* perfNames[PERF_COUNTERS];
+
+// One worker's perf_event_open group, around its event loop. Counters the kernel or the machine
+// refuses are left out of the group, the others still count
+struct perfGroup
+{
+    int fds[PERF_COUNTERS] = { -1, -1, -1, -1, -1 };
+    int leader = -1;
+    bool userOnly = false;          // perf_event_paranoid keeps the kernel side out
+    int error = 0;                  // errno of the first counter refused
+    bool valid[PERF_COUNTERS] = {};
+    uint64_t values[PERF_COUNTERS] = {};    // scaled up when the group was multiplexed
+};
+
+bool perfOpen(perfGroup&);
+void perfStart(perfGroup&);
+void perfStop(perfGroup&);
@@ -0,0 +1,149 @@
+#include "poll.hpp"
+
+#include <cerrno>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+bool pollInit(poller& p)
+{
+    p.fd = epoll_create1(0);
+    return p.fd != -1;
+}
+
+void pollClose(poller& p)
+{
+    if (p.fd != -1)
+        close(p.fd);
+
+    p.fd = -1;
+}
+
+void pollAdd(poller& p, int fd)
+{
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.fd = fd;
+
+    epoll_ctl(p.fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void pollWatch(poller&, int, bool)
+{
+    // Edge-triggered, nothing to change
+}
+
+void pollRemove(poller& p, int fd)
+{
+    epoll_ctl(p.fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+// Waits up to timeout_us (0 only polls) and appends the ready sockets
+int pollWait(poller& p, uint64_t timeout_us, std::vector<int>& ready)
+{
+    int timeout = static_cast<int>((timeout_us + 999) / 1000);
+
+    int n = epoll_wait(p.fd, p.events, POLL_EVENTS, timeout);
+    if (n == -1)
+        return errno == EINTR ? 0 : -1;
+
+    for (int i = 0; i < n; ++i)
+        ready.push_back(p.events[i].data.fd);
+
+    return n;
+}
+
+const char* pollName()
+{
+    return "epoll";
+}
+
+#else
+
+bool pollInit(poller& p)
+{
+    FD_ZERO(&p.read_fds);
+    FD_ZERO(&p.write_fds);
+    p.fds.clear();
+
+    return true;
+}
+
+void pollClose(poller& p)
+{
+    pollInit(p);
+}
+
+void pollAdd(poller& p, int fd)
+{
+    p.fds.push_back(fd);
+    FD_SET(fd, &p.write_fds);
+}
+
+// Only ask for writability while there is something to send
+void pollWatch(poller& p, int fd, bool write)
+{
+    if (write)
+    {
+        FD_CLR(fd, &p.read_fds);
+        FD_SET(fd, &p.write_fds);
+    }
+    else
+    {
+        FD_CLR(fd, &p.write_fds);
+        FD_SET(fd, &p.read_fds);
+    }
+}
+
+void pollRemove(poller& p, int fd)
+{
+    FD_CLR(fd, &p.read_fds);
+    FD_CLR(fd, &p.write_fds);
+
+    for (size_t i = 0; i < p.fds.size(); ++i)
+    {
+        if (p.fds[i] == fd)
+        {
+            p.fds[i] = p.fds.back();
+            p.fds.pop_back();
+            break;
+        }
+    }
+}
+
+int pollWait(poller& p, uint64_t timeout_us, std::vector<int>& ready)
+{
+    fd_set read_fds = p.read_fds;
+    fd_set write_fds = p.write_fds;
+
+    int max = 0;
+    for (int fd : p.fds)
+        if (fd > max)
+            max = fd;
+
+    struct timeval timeout;
+    timeout.tv_sec = static_cast<long>(timeout_us / 1000000);
+    timeout.tv_usec = static_cast<long>(timeout_us % 1000000);
+
+    int n = select(max + 1, &read_fds, &write_fds, NULL, &timeout);
+    if (n <= 0)
+        return n;
+
+    for (int fd : p.fds)
+    {
+        if (FD_ISSET(fd, &read_fds) || FD_ISSET(fd, &write_fds))
+            ready.push_back(fd);
+    }
+
+    return n;
+}
+
+const char* pollName()
+{
+    return "select";
+}
+
+#endif
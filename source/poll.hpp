@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#elif defined(__linux__)
+#include <sys/epoll.h>
+#else
+#include <sys/select.h>
+#endif
+
+#define POLL_EVENTS  256
+
+// Readiness backend of a worker.
+// Linux: edge-triggered epoll, every socket is registered once for read and write,
+// the connection state machine runs until EAGAIN so no interest changes are needed.
+// Elsewhere: select() with the interest following the connection phase.
+struct poller
+{
+#ifdef __linux__
+    int fd = -1;
+    epoll_event events[POLL_EVENTS];
+#else
+    fd_set read_fds;
+    fd_set write_fds;
+    std::vector<int> fds;
+#endif
+};
+
+bool pollInit(poller&);
+void pollClose(poller&);
+void pollAdd(poller&, int);
+void pollWatch(poller&, int, bool);
+void pollRemove(poller&, int);
+int pollWait(poller&, uint64_t, std::vector<int>&);
+const char* pollName();
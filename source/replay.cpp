@@ -0,0 +1,315 @@
+#include "replay.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+replayCursor::~replayCursor()
+{
+#ifndef _WIN32
+    if (data)
+        munmap(const_cast<char*>(data), size);
+#endif
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+int64_t civilDays(int64_t year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(year - era * 400);
+    unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+// [10/Oct/2000:13:55:36 -0700] of the common log format, without the brackets
+bool parseLogTime(const char* s, size_t length, int64_t& time_us)
+{
+    static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    std::string text(s, length);
+    char month[4] = {};
+    int day, year, hour, minute, second, zone = 0;
+
+    int fields = sscanf(text.c_str(), "%d/%3c/%d:%d:%d:%d %d", &day, month, &year, &hour, &minute, &second, &zone);
+    if (fields < 6)
+        return false;
+
+    unsigned m = 0;
+    while (m < 12 && strcmp(months[m], month))
+        m++;
+
+    if (m == 12)
+        return false;
+
+    // -0700 is seven hours behind UTC
+    int offset = (zone / 100) * 3600 + (zone % 100) * 60;
+    int64_t seconds = civilDays(year, m + 1, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+
+    time_us = seconds * 1000000;
+    return true;
+}
+
+// Seconds with up to six decimals, epoch or relative, as the first field of a TSV line
+bool parseSeconds(const char* s, size_t length, int64_t& time_us)
+{
+    int64_t whole = 0, fraction = 0;
+    size_t i = 0, digits = 0;
+
+    for (; i < length && isdigit(static_cast<unsigned char>(s[i])); ++i)
+        whole = whole * 10 + (s[i] - '0');
+
+    if (!i)
+        return false;
+
+    if (i < length && s[i] == '.')
+    {
+        for (++i; i < length && isdigit(static_cast<unsigned char>(s[i])); ++i)
+        {
+            if (digits++ < 6)
+                fraction = fraction * 10 + (s[i] - '0');
+        }
+    }
+
+    if (i != length)
+        return false;
+
+    for (; digits < 6; ++digits)
+        fraction *= 10;
+
+    time_us = whole * 1000000 + fraction;
+    return true;
+}
+
+bool validMethod(const std::string& method)
+{
+    if (method.empty())
+        return false;
+
+    for (char c : method)
+        if (!isupper(static_cast<unsigned char>(c)))
+            return false;
+
+    return true;
+}
+
+// One line of the log: common or combined log format, or timestamp<TAB>method<TAB>path
+bool replayParse(const char* line, size_t length, int64_t& time_us, std::string& method, std::string& path)
+{
+    const char* end = line + length;
+
+    if (length && end[-1] == '\r')
+        end--;
+
+    const char* tab = static_cast<const char*>(memchr(line, '\t', end - line));
+    if (tab)
+    {
+        const char* second = static_cast<const char*>(memchr(tab + 1, '\t', end - tab - 1));
+        if (!second || !parseSeconds(line, tab - line, time_us))
+            return false;
+
+        const char* last = static_cast<const char*>(memchr(second + 1, '\t', end - second - 1));
+
+        method.assign(tab + 1, second);
+        path.assign(second + 1, last ? last : end);
+
+        return validMethod(method) && !path.empty() && path[0] == '/';
+    }
+
+    const char* open = static_cast<const char*>(memchr(line, '[', end - line));
+    const char* close = open ? static_cast<const char*>(memchr(open, ']', end - open)) : nullptr;
+    if (!close || !parseLogTime(open + 1, close - open - 1, time_us))
+        return false;
+
+    // "GET /path HTTP/1.1", a bare "-" when the client sent nothing
+    const char* quote = static_cast<const char*>(memchr(close, '"', end - close));
+    const char* request = quote ? quote + 1 : nullptr;
+    const char* unquote = request ? static_cast<const char*>(memchr(request, '"', end - request)) : nullptr;
+    if (!unquote)
+        return false;
+
+    const char* space = static_cast<const char*>(memchr(request, ' ', unquote - request));
+    if (!space)
+        return false;
+
+    const char* target = space + 1;
+    const char* after = static_cast<const char*>(memchr(target, ' ', unquote - target));
+
+    method.assign(request, space);
+    path.assign(target, after ? after : unquote);
+
+    return validMethod(method) && !path.empty() && path[0] == '/';
+}
+
+// Next line of the mapping, empty lines and comments included, false at the end
+bool nextLine(replayCursor& c, const char*& line, size_t& length)
+{
+    if (c.position >= c.size)
+        return false;
+
+    line = c.data + c.position;
+    const char* newline = static_cast<const char*>(memchr(line, '\n', c.size - c.position));
+    length = newline ? static_cast<size_t>(newline - line) : c.size - c.position;
+    c.position += length + 1;
+
+    // Pages already read are dropped from this process, the log is never resident as a whole
+#ifndef _WIN32
+    while (c.position < c.size && c.position - c.released >= REPLAY_RELEASE)
+    {
+        madvise(const_cast<char*>(c.data) + c.released, REPLAY_RELEASE, MADV_DONTNEED);
+        c.released += REPLAY_RELEASE;
+    }
+#endif
+
+    return true;
+}
+
+bool blankLine(const char* line, size_t length)
+{
+    return !length || line[0] == '#' || (length == 1 && line[0] == '\r');
+}
+
+// Maps the log and finds the first request, the origin every offset is counted from
+bool replayOpen(replayCursor& c, const std::string& path, std::string& error)
+{
+#ifdef _WIN32
+    error = "replaying needs a memory-mapped log, not supported on Windows";
+    return false;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        error = "cannot read " + path;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !st.st_size)
+    {
+        close(fd);
+        error = "empty log " + path;
+        return false;
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        error = "cannot map " + path;
+        return false;
+    }
+
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    c.data = static_cast<const char*>(data);
+    c.size = st.st_size;
+
+    const char* line;
+    size_t length;
+    std::string method, target;
+
+    while (nextLine(c, line, length))
+    {
+        if (!blankLine(line, length) && replayParse(line, length, c.origin_us, method, target))
+        {
+            c.position = 0;
+            c.released = 0;
+            return true;
+        }
+    }
+
+    error = "no requests in " + path + ", expected common or combined log format, or timestamp, method and path separated by tabs";
+    return false;
+#endif
+}
+
+// Tops the lookahead up with this thread's lines
+void replayFill(replayCursor& c)
+{
+    const char* line;
+    size_t length;
+    int64_t time_us;
+
+    while (c.count < c.ring.size() && !c.ended)
+    {
+        if (!nextLine(c, line, length))
+        {
+            c.ended = true;
+            break;
+        }
+
+        if (blankLine(line, length) || c.line++ % c.threads != c.thread)
+            continue;
+
+        replayEntry& entry = c.ring[(c.head + c.count) % c.ring.size()];
+        if (!replayParse(line, length, time_us, entry.method, entry.path))
+        {
+            c.skipped++;
+            continue;
+        }
+
+        // Logs are written as requests end, a slightly earlier start is due right away
+        long double offset = static_cast<long double>(std::max<int64_t>(0, time_us - c.origin_us));
+        entry.due = c.start_us + static_cast<uint64_t>(offset / c.speedup);
+        c.count++;
+    }
+}
+
+// Earliest request of this thread that has not been sent, nullptr once the log is done
+const replayEntry* replayPeek(replayCursor& c)
+{
+    if (!c.count)
+        replayFill(c);
+
+    return c.count ? &c.ring[c.head] : nullptr;
+}
+
+void replayPop(replayCursor& c)
+{
+    c.head = (c.head + 1) % c.ring.size();
+    c.count--;
+    c.taken++;
+
+    replayFill(c);
+}
+
+bool replayEnded(replayCursor& c)
+{
+    return !replayPeek(c);
+}
+
+void replayLag(replayCursor& c, uint64_t lag_us)
+{
+    if (lag_us >= REPLAY_LATE_US)
+        c.late++;
+
+    c.lagMax = std::max(c.lagMax, lag_us);
+}
+
+void replayRender(const replayCursor& c, const replayEntry& entry, std::string& request)
+{
+    request.clear();
+    request += entry.method;
+    request += ' ';
+    request += entry.path;
+    request += " HTTP/1.1\r\nHost: ";
+    request += c.host;
+    request += "\r\n";
+
+    // Logs have no bodies, they are replayed empty
+    if (entry.method == "POST" || entry.method == "PUT" || entry.method == "PATCH")
+        request += "Content-Length: 0\r\n";
+
+    request += "\r\n";
+}
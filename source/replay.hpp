@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Entries parsed ahead of their time per thread: a thread that falls behind stops reading
+// the log instead of buffering it, late requests show up as latency
+#define REPLAY_LOOKAHEAD    256
+
+// Mapped log behind the reader is handed back to the kernel in steps of this many bytes
+#define REPLAY_RELEASE      (64ULL << 20)
+
+// Connections are opened before the first request is due
+#define REPLAY_LEAD_MS      200
+
+// Requests sent this much after they were due are counted as late
+#define REPLAY_LATE_US      1000
+
+// How often the main thread looks for the end of a replay, and the run length without -d
+#define REPLAY_POLL_MS      50
+#define REPLAY_UNCAPPED_S   (365ULL * 24 * 3600)
+
+struct replayEntry
+{
+    uint64_t due = 0;           // us, on the clockNow_us scale
+    std::string method;
+    std::string path;
+};
+
+// One thread's view of --replay: its own read-only mapping, every threads-th line of the log
+struct replayCursor
+{
+    ~replayCursor();
+
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t position = 0;
+    size_t released = 0;
+    uint64_t line = 0;
+    uint64_t thread = 0;
+    uint64_t threads = 1;
+    int64_t origin_us = 0;      // timestamp of the first request of the log
+    uint64_t start_us = 0;      // when it is replayed
+    long double speedup = 1;
+    std::string host;
+    std::vector<replayEntry> ring = std::vector<replayEntry>(REPLAY_LOOKAHEAD);
+    size_t head = 0;
+    size_t count = 0;
+    bool ended = false;
+    uint64_t taken = 0;
+    uint64_t skipped = 0;       // lines that are not a request
+    uint64_t late = 0;
+    uint64_t lagMax = 0;
+};
+
+bool replayParse(const char*, size_t, int64_t&, std::string&, std::string&);
+bool replayOpen(replayCursor&, const std::string&, std::string&);
+const replayEntry* replayPeek(replayCursor&);
+void replayPop(replayCursor&);
+bool replayEnded(replayCursor&);
+void replayLag(replayCursor&, uint64_t);
+void replayRender(const replayCursor&, const replayEntry&, std::string&);
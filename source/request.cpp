@@ -0,0 +1,79 @@
+#include "request.hpp"
+
+// Value of the Host header for one target, --host wins over the URL
+std::string hostHeader(const config& cfg, const ParsedURL& url)
+{
+    if (!cfg.host.empty())
+        return cfg.host;
+
+    return url.port.empty() ? url.host : url.host + ":" + url.port;
+}
+
+std::string makeRequest(const config cfg, const ParsedURL& url, bool full)
+{
+    std::string request; 
+
+    std::string method = cfg.method.empty() ? (cfg.body ? "POST" : "GET") : cfg.method;
+
+    request += method + " " + url.uri + " HTTP/1.1\r\n";
+    request += "Host: " + hostHeader(cfg, url) + "\r\n";
+
+    // The body itself is never copied in, it is sent from the shared mapping after this block
+    if (cfg.body)
+        request += "Content-Length: " + std::to_string(cfg.body->size) + "\r\n";
+    else if (method == "POST" || method == "PUT" || method == "PATCH")
+        request += "Content-Length: 0\r\n";
+
+    if (cfg.stream)
+        request += "Accept: text/event-stream\r\nCache-Control: no-cache\r\n";
+
+    if(full)
+    {
+        request += "User-Agent: mrk a HTTP benchmarking tool\r\n";
+        request += "Connection: keep-alive\r\n";
+    }
+        
+    return request + "\r\n";
+}
+
+bool bodyLoad(const std::string& path, requestBody& body)
+{
+#ifdef _WIN32
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+
+    char chunk[RECVBUF];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        body.buffer.insert(body.buffer.end(), chunk, chunk + n);
+
+    fclose(file);
+
+    body.data = body.buffer.data();
+    body.size = body.buffer.size();
+#else
+    body.fd = open(path.c_str(), O_RDONLY);
+    if (body.fd == -1)
+        return false;
+
+    struct stat st;
+    if (fstat(body.fd, &st) == -1)
+        return false;
+
+    body.size = st.st_size;
+    if (!body.size)
+        return true;
+
+    void* data = mmap(nullptr, body.size, PROT_READ, MAP_SHARED, body.fd, 0);
+    if (data == MAP_FAILED)
+    {
+        body.size = 0;
+        return false;
+    }
+
+    body.data = static_cast<const char*>(data);
+#endif
+
+    return true;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "common.hpp"
+
+std::string hostHeader(const config&, const ParsedURL&);
+std::string makeRequest(const config, const ParsedURL&, bool = false);
+
+bool bodyLoad(const std::string&, requestBody&);
@@ -0,0 +1,537 @@
+#include "scenario.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+int variableIndex(scenario& sc, const std::string& name)
+{
+    for (size_t i = 0; i < sc.variables.size(); ++i)
+        if (sc.variables[i] == name)
+            return static_cast<int>(i);
+
+    sc.variables.push_back(name);
+
+    return static_cast<int>(sc.variables.size() - 1);
+}
+
+// Literal text with ${name} references
+bool templateCompile(scenario& sc, const std::string& text, textTemplate& t, std::vector<int>& used)
+{
+    size_t i = 0;
+
+    while (i < text.size())
+    {
+        size_t open = text.find("${", i);
+        size_t close = open == std::string::npos ? open : text.find('}', open);
+
+        if (open == std::string::npos || close == std::string::npos)
+        {
+            t.push_back({ text.substr(i), -1 });
+            break;
+        }
+
+        if (open > i)
+            t.push_back({ text.substr(i, open - i), -1 });
+
+        std::string name = text.substr(open + 2, close - open - 2);
+        if (name.empty())
+            return false;
+
+        int variable = variableIndex(sc, name);
+        t.push_back({ "", variable });
+        used.push_back(variable);
+
+        i = close + 1;
+    }
+
+    return true;
+}
+
+// data.items[0].id, an optional leading $ is ignored
+bool pathCompile(std::string text, std::vector<jsonKey>& path)
+{
+    if (!text.empty() && text[0] == '$')
+        text.erase(0, 1);
+
+    size_t i = 0;
+    while (i < text.size())
+    {
+        if (text[i] == '.')
+        {
+            i++;
+            continue;
+        }
+
+        if (text[i] == '[')
+        {
+            size_t close = text.find(']', i);
+            if (close == std::string::npos || close == i + 1)
+                return false;
+
+            jsonKey hop;
+            for (size_t k = i + 1; k < close; ++k)
+            {
+                if (!isdigit(static_cast<unsigned char>(text[k])))
+                    return false;
+                hop.index = hop.index * 10 + (text[k] - '0');
+            }
+
+            path.push_back(hop);
+            i = close + 1;
+            continue;
+        }
+
+        size_t end = text.find_first_of(".[", i);
+        if (end == std::string::npos)
+            end = text.size();
+
+        path.push_back({ text.substr(i, end - i), 0 });
+        i = end;
+    }
+
+    return !path.empty();
+}
+
+std::string trim(const std::string& s)
+{
+    size_t begin = s.find_first_not_of(" \t\r");
+    size_t end = s.find_last_not_of(" \t\r");
+
+    return begin == std::string::npos ? "" : s.substr(begin, end - begin + 1);
+}
+
+// One directive per line:
+//   step <name>
+//   <METHOD> <uri>
+//   header <Name: value>
+//   body <text>
+//   extract <variable> header <Name>
+//   extract <variable> json <path>
+// uri, header values and body may use ${variable}, set by an extract of this or an earlier step
+bool scenarioParse(std::istream& file, scenario& sc, std::string& error)
+{
+    std::string line;
+    std::vector<int> used, extracted;
+    std::vector<size_t> usedAt, extractedAt;    // step of each use and extract
+    int number = 0;
+
+    while (std::getline(file, line))
+    {
+        number++;
+        line = trim(line);
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t space = line.find_first_of(" \t");
+        std::string word = line.substr(0, space);
+        std::string rest = space == std::string::npos ? "" : trim(line.substr(space));
+        std::string where = "line " + std::to_string(number) + ": ";
+
+        if (word == "step")
+        {
+            sc.steps.emplace_back();
+            sc.steps.back().name = rest.empty() ? std::to_string(sc.steps.size()) : rest;
+            continue;
+        }
+
+        if (sc.steps.empty())
+        {
+            error = where + "expected a step first";
+            return false;
+        }
+
+        scenarioStep& step = sc.steps.back();
+
+        if (word == "header")
+        {
+            if (rest.find(':') == std::string::npos || !templateCompile(sc, rest, step.headers.emplace_back(), used))
+            {
+                error = where + "expected header <Name: value>";
+                return false;
+            }
+        }
+        else if (word == "body")
+        {
+            step.hasBody = true;
+            if (!templateCompile(sc, rest, step.body, used))
+            {
+                error = where + "bad ${variable} in body";
+                return false;
+            }
+        }
+        else if (word == "extract")
+        {
+            std::string name, kind, arg;
+            size_t a = rest.find_first_of(" \t");
+            name = rest.substr(0, a);
+            rest = a == std::string::npos ? "" : trim(rest.substr(a));
+            size_t b = rest.find_first_of(" \t");
+            kind = rest.substr(0, b);
+            arg = b == std::string::npos ? "" : trim(rest.substr(b));
+
+            extractRule rule;
+            rule.variable = variableIndex(sc, name);
+            rule.kind = kind == "json" ? ExtractKind::JSON : ExtractKind::HEADER;
+
+            for (char c : arg)
+                rule.header += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+
+            if (name.empty() || arg.empty() || (kind != "json" && kind != "header") ||
+                (rule.kind == ExtractKind::JSON && !pathCompile(arg, rule.path)))
+            {
+                error = where + "expected extract <variable> header <Name> or extract <variable> json <path>";
+                return false;
+            }
+
+            step.capture |= rule.kind == ExtractKind::JSON;
+            sc.capture |= step.capture;
+            extracted.push_back(rule.variable);
+            extractedAt.push_back(sc.steps.size() - 1);
+            step.extracts.push_back(rule);
+        }
+        else if (!word.empty() && std::all_of(word.begin(), word.end(), [](char c) { return isupper(static_cast<unsigned char>(c)); }))
+        {
+            if (rest.empty() || rest[0] != '/' || !templateCompile(sc, rest, step.uri, used))
+            {
+                error = where + "expected <METHOD> </uri>";
+                return false;
+            }
+
+            step.method = word;
+        }
+        else
+        {
+            error = where + "unknown directive " + word;
+            return false;
+        }
+
+        usedAt.resize(used.size(), sc.steps.size() - 1);
+    }
+
+    if (sc.steps.empty())
+    {
+        error = "no steps";
+        return false;
+    }
+
+    for (const scenarioStep& step : sc.steps)
+    {
+        if (step.method.empty())
+        {
+            error = "step " + step.name + " has no request line";
+            return false;
+        }
+    }
+
+    // A value has to be extracted by the step using it, for its next round, or by one before it
+    for (size_t i = 0; i < used.size(); ++i)
+    {
+        bool set = false;
+        for (size_t k = 0; k < extracted.size() && !set; ++k)
+            set = extracted[k] == used[i] && extractedAt[k] <= usedAt[i];
+
+        if (!set)
+        {
+            error = "${" + sc.variables[used[i]] + "} is used by step " + sc.steps[usedAt[i]].name +
+                " but not extracted by it or an earlier step";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool scenarioLoad(const std::string& path, scenario& sc, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "cannot read " + path;
+        return false;
+    }
+
+    return scenarioParse(file, sc, error);
+}
+
+void sessionInit(session& s, const scenario& sc)
+{
+    s.step = 0;
+    s.values.resize(sc.variables.size());
+
+    for (std::string& value : s.values)
+        value.reserve(SCENARIO_VALUE_RESERVE);
+}
+
+void render(const textTemplate& t, const session& s, std::string& out)
+{
+    for (const templatePart& part : t)
+        out += part.variable < 0 ? part.text : s.values[part.variable];
+}
+
+// Request of the current step, rendered into request without giving up its capacity
+void sessionRequest(const scenario& sc, session& s, std::string& request)
+{
+    const scenarioStep& step = sc.steps[s.step];
+
+    s.capture.clear();
+    s.capturing = step.capture;
+
+    request.clear();
+    request += step.method;
+    request += ' ';
+    render(step.uri, s, request);
+    request += " HTTP/1.1\r\nHost: ";
+    request += sc.host;
+    request += "\r\n";
+
+    for (const textTemplate& header : step.headers)
+    {
+        render(header, s, request);
+        request += "\r\n";
+    }
+
+    s.body.clear();
+    if (step.hasBody)
+        render(step.body, s, s.body);
+
+    if (step.hasBody || step.method == "POST" || step.method == "PUT" || step.method == "PATCH")
+    {
+        char length[32];
+        snprintf(length, sizeof(length), "Content-Length: %zu\r\n", s.body.size());
+        request += length;
+    }
+
+    request += "\r\n";
+    request += s.body;
+}
+
+// Body span of the current step, kept only when it extracts from the body
+void sessionCapture(session& s, const char* data, size_t size)
+{
+    if (!s.capturing)
+        return;
+
+    size_t room = SCENARIO_CAPTURE_MAX - std::min<size_t>(s.capture.size(), SCENARIO_CAPTURE_MAX);
+    s.capture.append(data, std::min(size, room));
+}
+
+// Takes the values of the step just answered and moves on, back to the first step on a miss
+bool sessionNext(const scenario& sc, session& s, const httpResponse& response)
+{
+    const scenarioStep& step = sc.steps[s.step];
+    bool found = true;
+
+    for (const extractRule& rule : step.extracts)
+    {
+        const char* value = nullptr;
+        size_t size = 0;
+
+        bool hit = rule.kind == ExtractKind::HEADER ? headerLookup(response.header, rule.header, value, size)
+            : jsonLookup(s.capture.data(), s.capture.size(), rule.path, value, size);
+
+        if (hit)
+            s.values[rule.variable].assign(value, size);
+        else
+            found = false;
+    }
+
+    s.step = found ? (s.step + 1) % sc.steps.size() : 0;
+
+    return found;
+}
+
+// Value of the first header called name (lower case), surrounding spaces trimmed
+bool headerLookup(const std::vector<char>& header, const std::string& name, const char*& value, size_t& size)
+{
+    const char* line = header.data();
+    const char* end = line + header.size();
+
+    while (line < end)
+    {
+        const char* eol = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!eol)
+            eol = end;
+
+        size_t n = eol - line;
+        bool match = n > name.size() && line[name.size()] == ':';
+
+        for (size_t i = 0; match && i < name.size(); ++i)
+            match = tolower(static_cast<unsigned char>(line[i])) == name[i];
+
+        if (match)
+        {
+            const char* p = line + name.size() + 1;
+            const char* q = eol;
+
+            while (p < q && (*p == ' ' || *p == '\t'))
+                p++;
+            while (q > p && (q[-1] == '\r' || q[-1] == ' ' || q[-1] == '\t'))
+                q--;
+
+            value = p;
+            size = q - p;
+            return true;
+        }
+
+        line = eol + 1;
+    }
+
+    return false;
+}
+
+const char* jsonSpace(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+
+    return p;
+}
+
+// Just past the string starting at p, nullptr when it does not end
+const char* jsonString(const char* p, const char* end)
+{
+    for (p++; p < end; ++p)
+    {
+        if (*p == '\\')
+            p++;
+        else if (*p == '"')
+            return p + 1;
+    }
+
+    return nullptr;
+}
+
+// Just past the value starting at p, nested values are skipped without being looked at
+const char* jsonSkip(const char* p, const char* end)
+{
+    if (p >= end)
+        return nullptr;
+
+    if (*p == '"')
+        return jsonString(p, end);
+
+    if (*p != '{' && *p != '[')
+    {
+        while (p < end && !strchr(",}] \t\r\n", *p))
+            p++;
+
+        return p;
+    }
+
+    int depth = 0;
+    while (p < end)
+    {
+        if (*p == '"')
+        {
+            p = jsonString(p, end);
+            if (!p)
+                return nullptr;
+            continue;
+        }
+
+        if (*p == '{' || *p == '[')
+            depth++;
+        else if ((*p == '}' || *p == ']') && !--depth)
+            return p + 1;
+
+        p++;
+    }
+
+    return nullptr;
+}
+
+// Walks path through the document without building it; strings come back without quotes, escapes as they are
+bool jsonLookup(const char* data, size_t size, const std::vector<jsonKey>& path, const char*& value, size_t& length)
+{
+    const char* end = data + size;
+    const char* p = jsonSpace(data, end);
+
+    for (const jsonKey& hop : path)
+    {
+        if (!hop.key.empty())
+        {
+            if (p >= end || *p != '{')
+                return false;
+
+            p = jsonSpace(p + 1, end);
+
+            while (true)
+            {
+                if (p >= end || *p != '"')
+                    return false;
+
+                const char* name = p + 1;
+                p = jsonString(p, end);
+                if (!p)
+                    return false;
+
+                bool match = static_cast<size_t>(p - 1 - name) == hop.key.size() && memcmp(name, hop.key.data(), hop.key.size()) == 0;
+
+                p = jsonSpace(p, end);
+                if (p >= end || *p != ':')
+                    return false;
+
+                p = jsonSpace(p + 1, end);
+                if (match)
+                    break;
+
+                p = jsonSkip(p, end);
+                if (!p)
+                    return false;
+
+                p = jsonSpace(p, end);
+                if (p >= end || *p != ',')
+                    return false;
+
+                p = jsonSpace(p + 1, end);
+            }
+        }
+        else
+        {
+            if (p >= end || *p != '[')
+                return false;
+
+            p = jsonSpace(p + 1, end);
+
+            for (size_t i = 0; i < hop.index; ++i)
+            {
+                if (p >= end || *p == ']')
+                    return false;
+
+                p = jsonSkip(p, end);
+                if (!p)
+                    return false;
+
+                p = jsonSpace(p, end);
+                if (p >= end || *p != ',')
+                    return false;
+
+                p = jsonSpace(p + 1, end);
+            }
+
+            if (p >= end || *p == ']')
+                return false;
+        }
+    }
+
+    const char* stop = jsonSkip(p, end);
+    if (!stop || stop == p)
+        return false;
+
+    if (*p == '"')
+    {
+        value = p + 1;
+        length = stop - p - 2;
+    }
+    else
+    {
+        value = p;
+        length = stop - p;
+    }
+
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <istream>
+
+#include "parser.hpp"
+
+// Body bytes kept per connection for json extraction, the rest of a longer body is not looked at
+#define SCENARIO_CAPTURE_MAX    (1024 * 1024)
+
+// Room reserved once per extracted value, longer values still fit but allocate
+#define SCENARIO_VALUE_RESERVE  256
+
+// Literal text or the current value of a variable
+struct templatePart
+{
+    std::string text;
+    int variable = -1;
+};
+
+typedef std::vector<templatePart> textTemplate;
+
+enum class ExtractKind
+{
+    HEADER,
+    JSON
+};
+
+// One hop of a json path: a member name, or an array index when key is empty
+struct jsonKey
+{
+    std::string key;
+    size_t index = 0;
+};
+
+struct extractRule
+{
+    int variable;
+    ExtractKind kind;
+    std::string header;
+    std::vector<jsonKey> path;
+};
+
+struct scenarioStep
+{
+    std::string name;
+    std::string method;
+    textTemplate uri;
+    std::vector<textTemplate> headers;
+    textTemplate body;
+    bool hasBody = false;
+    bool capture = false;       // extracts from the body
+    std::vector<extractRule> extracts;
+};
+
+// Compiled scenario file, shared read-only by every connection
+struct scenario
+{
+    std::vector<scenarioStep> steps;
+    std::vector<std::string> variables;
+    std::string host;
+    bool capture = false;       // some step extracts from the body
+};
+
+// Where one connection is in the scenario, buffers are reused from one step to the next
+struct session
+{
+    size_t step = 0;
+    bool capturing = false;
+    std::vector<std::string> values;
+    std::string body;
+    std::string capture;
+};
+
+bool scenarioParse(std::istream&, scenario&, std::string&);
+bool scenarioLoad(const std::string&, scenario&, std::string&);
+
+void sessionInit(session&, const scenario&);
+void sessionRequest(const scenario&, session&, std::string&);
+void sessionCapture(session&, const char*, size_t);
+bool sessionNext(const scenario&, session&, const httpResponse&);
+
+bool headerLookup(const std::vector<char>&, const std::string&, const char*&, size_t&);
+bool jsonLookup(const char*, size_t, const std::vector<jsonKey>&, const char*&, size_t&);
@@ -0,0 +1,137 @@
+#include "search.hpp"
+#include "units.hpp"
+
+#define SEARCH_PERCENTILES  { 50.0L, 90.0L, 99.0L, 99.9L }
+
+// Comma separated pNN<time or max<time bounds, times in us, ms or s
+int scanSLO(std::string s, sloTarget& target)
+{
+    std::stringstream items(s);
+    std::string item;
+
+    target.text = s;
+
+    while (std::getline(items, item, ','))
+    {
+        size_t less = item.find('<');
+        if (less == std::string::npos || less + 1 == item.size())
+            return 1;
+
+        std::string name = item.substr(0, less);
+        std::string limit = item.substr(less + 1);
+        sloRule rule;
+
+        if (name == "max")
+        {
+            rule.percentile = 100.0L;
+        }
+        else if (name.size() > 1 && name[0] == 'p')
+        {
+            char* end = nullptr;
+            rule.percentile = strtold(name.c_str() + 1, &end);
+            if (*end || rule.percentile <= 0 || rule.percentile > 100)
+                return 1;
+        }
+        else
+        {
+            return 1;
+        }
+
+        if (!isdigit(static_cast<unsigned char>(limit[0])) || scanTime_us(limit, rule.limit_us) || !rule.limit_us)
+            return 1;
+
+        target.rules.push_back(rule);
+    }
+
+    return target.rules.empty();
+}
+
+bool sloMet(const sloTarget& target, std::unique_ptr<stats>& latency)
+{
+    if (!latency->count)
+        return false;
+
+    for (const sloRule& rule : target.rules)
+    {
+        uint64_t value = rule.percentile >= 100.0L ? latency->max : stats_percentile(latency, rule.percentile);
+        if (value >= rule.limit_us)
+            return false;
+    }
+
+    return true;
+}
+
+// Concurrency of the next step, 0 once the search is over
+uint64_t searchNext(const search& s)
+{
+    if (!s.high)
+    {
+        // Doubling, the last step runs at the maximum exactly
+        if (s.low == s.max)
+            return 0;
+
+        return s.low ? std::min(s.low * 2, s.max) : 1;
+    }
+
+    uint64_t gap = std::max<uint64_t>(1, s.low * SEARCH_RESOLUTION_PCT / 100);
+    if (s.high - s.low <= gap)
+        return 0;
+
+    return s.low + (s.high - s.low) / 2;
+}
+
+void searchRecord(search& s, searchStep&& step)
+{
+    if (step.met)
+        s.low = std::max(s.low, step.concurrency);
+    else if (!s.high || step.concurrency < s.high)
+        s.high = step.concurrency;
+
+    s.steps.push_back(std::move(step));
+}
+
+// Highest throughput among the steps that met the SLO
+const searchStep* searchBest(const search& s)
+{
+    const searchStep* best = nullptr;
+
+    for (const searchStep& step : s.steps)
+        if (step.met && (!best || step.rate > best->rate))
+            best = &step;
+
+    return best;
+}
+
+void searchPrintHeader()
+{
+    printf("  Conns%12s%9s%9s%9s%9s%9s\n", "Req/Sec", "p50", "p90", "p99", "p99.9", "Max");
+}
+
+void searchPrintStep(searchStep& step)
+{
+    printf("  %5llu", (unsigned long long)step.concurrency);
+    printf("%12s", formatMetric(step.rate).c_str());
+
+    for (long double p : SEARCH_PERCENTILES)
+        printf("%9s", formatTime_us(static_cast<long double>(stats_percentile(step.latency, p))).c_str());
+
+    printf("%9s  %s\n", formatTime_us(static_cast<long double>(step.latency->max)).c_str(), step.met ? "ok" : "over");
+    fflush(stdout);
+}
+
+void searchPrint(const search& s, const sloTarget& target)
+{
+    const searchStep* best = searchBest(s);
+
+    if (!best)
+    {
+        printf("  No step met %s, not even one connection\n", target.text.c_str());
+        return;
+    }
+
+    printf("  Highest throughput within %s: %s req/s with %llu connections\n", target.text.c_str(),
+        formatMetric(best->rate).c_str(), (unsigned long long)best->concurrency);
+
+    if (s.low == s.max)
+        printf("  The SLO held up to -c %llu, open more connections to search further\n", (unsigned long long)s.max);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "stats.hpp"
+
+// Binary search stops once the bounds are this close, in percent of the best concurrency
+#define SEARCH_RESOLUTION_PCT   5
+
+// One bound of a latency SLO, max is percentile 100
+struct sloRule
+{
+    long double percentile;
+    uint64_t limit_us;
+};
+
+// --search target, e.g. p99<50ms or p50<2ms,p99.9<20ms
+struct sloTarget
+{
+    std::vector<sloRule> rules;
+    std::string text;
+};
+
+struct searchStep
+{
+    uint64_t concurrency;
+    long double rate;
+    bool met;
+    std::unique_ptr<stats> latency;
+};
+
+// Concurrency search: doubling until the SLO breaks, then bisecting between the last step
+// that held it and the first one that did not
+struct search
+{
+    uint64_t max = 0;
+    uint64_t low = 0;           // highest concurrency that met the SLO
+    uint64_t high = 0;          // lowest that did not, 0 while doubling
+    std::vector<searchStep> steps;
+};
+
+int scanSLO(std::string, sloTarget&);
+bool sloMet(const sloTarget&, std::unique_ptr<stats>&);
+
+uint64_t searchNext(const search&);
+void searchRecord(search&, searchStep&&);
+const searchStep* searchBest(const search&);
+
+void searchPrintHeader();
+void searchPrintStep(searchStep&);
+void searchPrint(const search&, const sloTarget&);
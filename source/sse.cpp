@@ -0,0 +1,241 @@
+#include "sse.hpp"
+
+#include <cctype>
+#include <cstring>
+
+// A json field of the event data holding a number, or id for the id line
+int scanEventTime(std::string s, eventTime& time)
+{
+    if (s.empty() || s.find('"') != std::string::npos)
+        return -1;
+
+    time.field = s;
+    time.id = s == "id";
+    time.needle = "\"" + s + "\"";
+
+    // Longest proper prefix of needle[0..i] that is also its suffix
+    const std::string& d = time.needle;
+    time.fallback.assign(d.size(), 0);
+
+    for (size_t i = 1, k = 0; i < d.size(); ++i)
+    {
+        while (k && d[i] != d[k])
+            k = time.fallback[k - 1];
+        if (d[i] == d[k])
+            k++;
+        time.fallback[i] = k;
+    }
+
+    return 0;
+}
+
+void stampReset(sseParser& p)
+{
+    p.stage = StampState::SEEK;
+    p.matched = 0;
+    p.whole = 0;
+    p.fraction = 0;
+    p.digits = 0;
+}
+
+void sseReset(sseParser& p)
+{
+    p.cr = false;
+    p.named = false;
+    p.nameLength = 0;
+    p.column = 0;
+    p.field = SseField::NONE;
+    p.data = false;
+    p.stamp_us = 0;
+
+    stampReset(p);
+}
+
+// Epoch seconds, milliseconds, microseconds or nanoseconds, told apart by their magnitude
+uint64_t stampValue(const sseParser& p)
+{
+    uint64_t fraction = p.fraction;
+    for (int d = p.digits; d < 6; ++d)
+        fraction *= 10;
+
+    if (p.whole < 100000000000ULL)
+        return p.whole * 1000000 + fraction;
+    if (p.whole < 100000000000000ULL)
+        return p.whole * 1000 + fraction / 1000;
+    if (p.whole < 100000000000000000ULL)
+        return p.whole;
+
+    return p.whole / 1000;
+}
+
+// One byte of a value the timestamp may be in
+void stampByte(sseParser& p, const eventTime& time, char c)
+{
+    switch (p.stage)
+    {
+    case StampState::SEEK:
+    {
+        const std::string& d = time.needle;
+
+        while (p.matched && c != d[p.matched])
+            p.matched = time.fallback[p.matched - 1];
+
+        if (c == d[p.matched] && ++p.matched == d.size())
+        {
+            p.matched = 0;
+            p.stage = StampState::COLON;
+        }
+        break;
+    }
+    case StampState::COLON:
+        if (c == ':')
+            p.stage = StampState::VALUE;
+        else if (c != ' ' && c != '\t')
+            p.stage = StampState::SEEK;
+        break;
+
+    case StampState::VALUE:
+        // Numbers sent as strings too
+        if (isdigit(static_cast<unsigned char>(c)))
+        {
+            p.whole = c - '0';
+            p.stage = StampState::DIGITS;
+        }
+        else if (c != ' ' && c != '\t' && c != '"')
+            p.stage = time.id ? StampState::DONE : StampState::SEEK;
+        break;
+
+    case StampState::DIGITS:
+        if (isdigit(static_cast<unsigned char>(c)) && p.whole < UINT64_MAX / 10)
+            p.whole = p.whole * 10 + (c - '0');
+        else if (c == '.')
+            p.stage = StampState::FRACTION;
+        else
+            p.stage = StampState::DONE;
+        break;
+
+    case StampState::FRACTION:
+        if (!isdigit(static_cast<unsigned char>(c)))
+            p.stage = StampState::DONE;
+        else if (p.digits < 6)
+        {
+            p.fraction = p.fraction * 10 + (c - '0');
+            p.digits++;
+        }
+        break;
+
+    case StampState::DONE:
+        break;
+    }
+}
+
+SseField fieldOf(const sseParser& p)
+{
+    if (p.nameLength == 4 && memcmp(p.name, "data", 4) == 0)
+        return SseField::DATA;
+    if (p.nameLength == 2 && memcmp(p.name, "id", 2) == 0)
+        return SseField::ID;
+
+    return SseField::OTHER;
+}
+
+// Whether the bytes of this line's value go through the timestamp matcher
+bool stamping(const sseParser& p, const eventTime* time)
+{
+    if (!time || p.stage == StampState::DONE)
+        return false;
+
+    return time->id ? p.field == SseField::ID : p.field == SseField::DATA;
+}
+
+// End of a line, true when it was the blank line dispatching an event
+bool lineEnd(sseParser& p, const eventTime* time)
+{
+    bool blank = !p.column;
+
+    if (!p.named && p.nameLength && fieldOf(p) == SseField::DATA)
+        p.data = true;
+
+    // A number running to the end of the line is complete, a json name split over lines is not
+    if (p.stage == StampState::DIGITS || p.stage == StampState::FRACTION)
+        p.stage = StampState::DONE;
+    else if (p.stage == StampState::SEEK)
+        p.matched = 0;
+    else if (time && time->id && p.field == SseField::ID)
+        p.stage = StampState::SEEK;
+
+    p.named = false;
+    p.nameLength = 0;
+    p.column = 0;
+    p.field = SseField::NONE;
+
+    return blank;
+}
+
+// Consumes bytes of the stream up to the end of the next event, event tells whether one ended
+size_t sseParse(sseParser& p, const eventTime* time, const char* data, size_t size, bool& event)
+{
+    size_t i = 0;
+    event = false;
+
+    while (i < size)
+    {
+        char c = data[i++];
+
+        if (c == '\n' && p.cr)
+        {
+            p.cr = false;
+            continue;
+        }
+
+        p.cr = c == '\r';
+
+        if (c == '\n' || c == '\r')
+        {
+            if (!lineEnd(p, time))
+                continue;
+
+            // An event without data is not dispatched, a run of blank lines ends nothing
+            if (!p.data)
+                continue;
+
+            p.stamp_us = p.stage == StampState::DONE && p.whole ? stampValue(p) : 0;
+            p.data = false;
+            stampReset(p);
+
+            event = true;
+            break;
+        }
+
+        p.column++;
+
+        if (!p.named)
+        {
+            if (c != ':')
+            {
+                if (p.nameLength < SSE_NAME_MAX)
+                    p.name[p.nameLength] = c;
+
+                p.nameLength++;
+                continue;
+            }
+
+            p.named = true;
+            p.field = !p.nameLength ? SseField::COMMENT : p.nameLength <= SSE_NAME_MAX ? fieldOf(p) : SseField::OTHER;
+
+            if (p.field == SseField::DATA)
+                p.data = true;
+
+            // The value of an id line is the timestamp itself
+            if (time && time->id && p.field == SseField::ID && p.stage == StampState::SEEK)
+                p.stage = StampState::VALUE;
+
+            continue;
+        }
+
+        if (stamping(p, time))
+            stampByte(p, *time, c);
+    }
+
+    return i;
+}
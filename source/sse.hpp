@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Longest field name told apart, "event" and "retry"
+#define SSE_NAME_MAX        5
+
+enum class SseField
+{
+    NONE,
+    COMMENT,
+    DATA,
+    ID,
+    OTHER
+};
+
+enum class StampState
+{
+    SEEK,           // looking for the field name, or waiting for an id line
+    COLON,
+    VALUE,
+    DIGITS,
+    FRACTION,
+    DONE
+};
+
+// Where --event-time finds the sender's timestamp: a json field of the data, or the id line
+struct eventTime
+{
+    std::string field;
+    bool id = false;
+    std::string needle;                 // "field" as it appears in the data
+    std::vector<size_t> fallback;       // KMP table of needle, matches survive split reads
+};
+
+// Incremental text/event-stream parser, events end at their blank line. Nothing of the stream
+// is kept: a few bytes of field name and the timestamp being read
+struct sseParser
+{
+    bool cr = false;            // last byte was \r, a \n right after it ends nothing
+    bool named = false;         // past the field name of the line
+    char name[SSE_NAME_MAX];
+    size_t nameLength = 0;
+    size_t column = 0;
+    SseField field = SseField::NONE;
+    bool data = false;          // the event has a data line, without one it is not dispatched
+
+    StampState stage = StampState::SEEK;
+    size_t matched = 0;
+    uint64_t whole = 0;
+    uint64_t fraction = 0;
+    int digits = 0;
+
+    uint64_t stamp_us = 0;      // of the event just dispatched, 0 without one
+};
+
+int scanEventTime(std::string, eventTime&);
+
+void sseReset(sseParser&);
+size_t sseParse(sseParser&, const eventTime*, const char*, size_t, bool&);
@@ -1,5 +1,10 @@
 
 #include "stats.hpp"
+#include "common.hpp"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 void statsInit(std::unique_ptr<stats>& statis, uint64_t max)
 {
@@ -7,12 +12,36 @@ void statsInit(std::unique_ptr<stats>& statis, uint64_t max)
     
     statis->limit = limit;
     statis->count = 0;
+    statis->sum = 0;
     statis->min = UINT64_MAX;
     statis->max = 0;
     
-    // Initialize data vector with atomic values
-    for (uint64_t i = 0; i < limit; ++i) 
-        statis->data.emplace_back(std::make_unique<std::atomic<uint64_t>>());    
+    statis->data.assign(stats_bucket(max) + 1, 0);
+}
+
+const char* timingNames[TIMINGS] = { "Connect", "Send", "Wait", "Transfer" };
+
+const char* stampNames[STAMPS] = { "User", "Kernel", "Client" };
+
+void timingInit(timingStats& timing, uint64_t max)
+{
+    for (auto& phase : timing.phase)
+    {
+        phase = std::make_unique<stats>();
+        statsInit(phase, max);
+    }
+}
+
+void timingMerge(timingStats& dest, timingStats& src)
+{
+    for (int i = 0; i < TIMINGS; ++i)
+        stats_merge(dest.phase[i], src.phase[i]);
+}
+
+void timingReset(timingStats& timing)
+{
+    for (auto& phase : timing.phase)
+        stats_reset(phase);
 }
 
 std::chrono::high_resolution_clock::time_point timeNow(int add)
@@ -39,35 +68,111 @@ long long getTime_us(const std::chrono::high_resolution_clock::time_point& start
     return std::chrono::duration_cast<std::chrono::microseconds>(timeNow() - startTime).count();
 }
 
+// CPU time (user + system) consumed by the calling thread
+uint64_t threadCpu_us()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+
+    uint64_t k = (static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+    uint64_t u = (static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+
+    return (k + u) / 10;
+#elif defined(RUSAGE_THREAD)
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == -1)
+        return 0;
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#else
+    return 0;
+#endif
+}
+
+// Bucket holding n
+size_t stats_bucket(uint64_t n)
+{
+    if (n < (2ULL << STATS_SUB_BITS))
+        return static_cast<size_t>(n);
+
+    int exponent = 63;
+#if defined(__GNUC__)
+    exponent -= __builtin_clzll(n);
+#else
+    while (!(n >> exponent))
+        exponent--;
+#endif
+
+    int shift = exponent - STATS_SUB_BITS;
+
+    return (static_cast<size_t>(shift) << STATS_SUB_BITS) + static_cast<size_t>(n >> shift);
+}
+
+// Lowest value of bucket i
+uint64_t stats_value(size_t i)
+{
+    if (i < (2ULL << STATS_SUB_BITS))
+        return i;
+
+    int shift = static_cast<int>(i >> STATS_SUB_BITS) - 1;
+
+    return static_cast<uint64_t>(i - (static_cast<size_t>(shift) << STATS_SUB_BITS)) << shift;
+}
+
+uint64_t stats_width(size_t i)
+{
+    return i < (2ULL << STATS_SUB_BITS) ? 1 : 1ULL << ((i >> STATS_SUB_BITS) - 1);
+}
+
+// Value standing for every sample of bucket i, its midpoint kept within what was recorded
+long double stats_middle(std::unique_ptr<stats>& statis, size_t i)
+{
+    long double middle = stats_value(i) + (stats_width(i) - 1) / 2.0L;
+
+    return std::min<long double>(std::max<long double>(middle, statis->min), statis->max);
+}
+
 int stats_record(std::unique_ptr<stats>& statis, uint64_t n) 
 {
     if (n >= statis->limit) return 0;
 
-    statis->data[n]->fetch_add(1, std::memory_order_relaxed);
-    statis->count.fetch_add(1, std::memory_order_relaxed);
-    uint64_t min = statis->min.load(std::memory_order_relaxed);
-    uint64_t max = statis->max.load(std::memory_order_relaxed);
-    
-    while (n < min) 
-        statis->min.compare_exchange_weak(min, n, std::memory_order_relaxed);
-    
-    while (n > max) 
-        statis->max.compare_exchange_weak(max, n, std::memory_order_relaxed);
+    statis->data[stats_bucket(n)]++;
+    statis->count++;
+    statis->sum += n;
+
+    if (n < statis->min)
+        statis->min = n;
+
+    if (n > statis->max)
+        statis->max = n;
     
     return 1;
 }
 
+// Coordinated omission: a request that took n blocked the ones due every expected meanwhile
 void stats_correct(std::unique_ptr<stats>& statis, int64_t expected) 
 {
-    for (uint64_t n = static_cast<uint64_t>(expected) * 2; n <= static_cast<uint64_t>(statis->max); n++) 
+    if (expected <= 0 || !statis->count)
+        return;
+
+    size_t last = stats_bucket(statis->max);
+
+    for (size_t i = stats_bucket(static_cast<uint64_t>(expected) * 2); i <= last && i < statis->data.size(); i++) 
     {
-        uint64_t count = statis->data[n]->load();
-        int64_t m = static_cast<int64_t>(n) - expected;
+        uint64_t count = statis->data[i];
+        int64_t m = static_cast<int64_t>(stats_value(i)) - expected;
 
         while (count && m > expected) 
         {
-            statis->data[static_cast<size_t>(m)]->fetch_add(count);
-            statis->count.fetch_add(count);
+            statis->data[stats_bucket(m)] += count;
+            statis->count += count;
+            statis->sum += m * count;
+
+            if (static_cast<uint64_t>(m) < statis->min)
+                statis->min = m;
+
             m -= expected;
         }
     }
@@ -77,11 +182,7 @@ long double stats_mean(std::unique_ptr<stats>& statis)
 {
     if (statis->count == 0) return 0.0;
 
-    uint64_t sum = 0;
-    for (uint64_t i = statis->min; i <= statis->max; i++) 
-        sum += *statis->data[i] * i;
-    
-    return sum / (long double)statis->count;
+    return statis->sum / (long double)statis->count;
 }
 
 long double stats_stdev(std::unique_ptr<stats>& statis, long double mean)
@@ -89,10 +190,10 @@ long double stats_stdev(std::unique_ptr<stats>& statis, long double mean)
     long double sum = 0.0;
     if (statis->count < 2) return 0.0;
     
-    for (uint64_t i = statis->min; i <= statis->max; i++) 
+    for (size_t i = stats_bucket(statis->min); i <= stats_bucket(statis->max); i++) 
     {
         if (statis->data[i]) 
-            sum += statis->data[i]->load() * powl(i - mean, 2);
+            sum += statis->data[i] * powl(stats_middle(statis, i) - mean, 2);
     }
 
     return sqrtl(sum / (statis->count - 1));
@@ -104,14 +205,69 @@ long double stats_within_stdev(std::unique_ptr<stats>& statis, long double mean,
     long double lower = mean - (stdev * n);
     uint64_t sum = 0;
 
-    for (uint64_t i = statis->min; i <= statis->max; i++)
+    if (statis->count == 0) 
+        return 0.0;
+
+    for (size_t i = stats_bucket(statis->min); i <= stats_bucket(statis->max); i++)
     {
-        if (i >= lower && i <= upper)
-            sum += statis->data[i]->load();
+        long double value = stats_middle(statis, i);
+
+        if (value >= lower && value <= upper)
+            sum += statis->data[i];
     }
-        
-    if (statis->count.load() == 0) 
-        return 0.0;
     
-    return (sum / (long double)statis->count.load()) * 100;
+    return (sum / (long double)statis->count) * 100;
+}
+
+// Highest value equivalent to the p-th percentile sample
+uint64_t stats_percentile(std::unique_ptr<stats>& statis, long double p)
+{
+    uint64_t count = statis->count;
+    if (count == 0) 
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>((p / 100.0) * count + 0.5);
+    if (rank < 1) 
+        rank = 1;
+
+    uint64_t total = 0;
+    for (size_t i = stats_bucket(statis->min); i <= stats_bucket(statis->max); i++)
+    {
+        total += statis->data[i];
+        if (total >= rank)
+            return std::max(statis->min, std::min(statis->max, stats_value(i) + stats_width(i) - 1));
+    }
+
+    return statis->max;
+}
+
+void stats_merge(std::unique_ptr<stats>& dest, std::unique_ptr<stats>& src)
+{
+    if (!src->count)
+        return;
+
+    size_t last = std::min(stats_bucket(src->max), dest->data.size() - 1);
+
+    for (size_t i = stats_bucket(src->min); i <= last; i++)
+        dest->data[i] += src->data[i];
+
+    dest->count += src->count;
+    dest->sum += src->sum;
+    dest->min = std::min(dest->min, src->min);
+    dest->max = std::max(dest->max, src->max);
+}
+
+// Empties the histogram, only the buckets that were used are touched
+void stats_reset(std::unique_ptr<stats>& statis)
+{
+    if (statis->count)
+    {
+        size_t last = std::min(stats_bucket(statis->max), statis->data.size() - 1);
+        std::fill(statis->data.begin() + stats_bucket(statis->min), statis->data.begin() + last + 1, 0);
+    }
+
+    statis->count = 0;
+    statis->sum = 0;
+    statis->min = UINT64_MAX;
+    statis->max = 0;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <cstddef>
 #include <memory>
 #include <atomic>
 #include <vector>
@@ -13,26 +15,85 @@ struct errorsData
     uint32_t write;
     uint32_t status;
     uint32_t timeout;
+    uint32_t validation;
+    uint32_t refused;   // connect errors: connection refused
+    uint32_t reset;     // read and write errors: reset by peer, broken pipe
+    uint32_t eof;       // read errors: closed before the response was complete
+    uint32_t parse;     // malformed status line, chunk framing or extra bytes
 };
 
+// Event loop overhead of one worker, plain counters owned by that thread
+struct clientStats
+{
+    uint64_t iterations;
+    uint64_t wakeups;
+    uint64_t events;
+    uint64_t syscalls;
+    uint64_t again;
+    uint64_t partial;
+    uint64_t wait_us;
+    uint64_t wall_us;
+    uint64_t cpu_us;
+};
+
+// Log-linear buckets: exact below 2^(STATS_SUB_BITS + 1), then 2^STATS_SUB_BITS buckets per
+// power of two, under 1% relative error in a few KB whatever the range
+#define STATS_SUB_BITS  7
+
+// Histogram owned by one thread, merged into the totals once the run is over
 struct stats 
 {
     uint64_t limit;
-    std::vector<std::unique_ptr<std::atomic<uint64_t>>> data;
-    std::atomic<uint64_t> count;
-    std::atomic<uint64_t> min;
-    std::atomic<uint64_t> max;
+    std::vector<uint64_t> data;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+};
+
+// Where the time of a request goes: connecting, once per connection, then sending the request,
+// waiting for the first byte of the answer and transferring the rest
+enum timing
+{
+    TIMING_CONNECT, TIMING_SEND, TIMING_WAIT, TIMING_TRANSFER, TIMINGS
+};
+
+struct timingStats
+{
+    std::unique_ptr<stats> phase[TIMINGS];
+};
+
+extern const char* timingNames[TIMINGS];
+
+// --kernel-time: every answer timed twice, by mrk's clock reads and by the kernel's send and
+// receive timestamps, and the difference: what mrk itself adds on both ends
+enum stamp
+{
+    STAMP_USER, STAMP_KERNEL, STAMP_CLIENT, STAMPS
 };
 
+extern const char* stampNames[STAMPS];
+
 void statsInit(std::unique_ptr<stats>&, uint64_t);
+void timingInit(timingStats&, uint64_t);
+void timingMerge(timingStats&, timingStats&);
+void timingReset(timingStats&);
 
 std::chrono::high_resolution_clock::time_point timeNow(int = 0);
 bool hasTimePassed(const std::chrono::high_resolution_clock::time_point&, int);
 long long getTime_s(const std::chrono::high_resolution_clock::time_point&);
 long long getTime_us(const std::chrono::high_resolution_clock::time_point&);
+uint64_t threadCpu_us();
+
+size_t stats_bucket(uint64_t);
+uint64_t stats_value(size_t);
+uint64_t stats_width(size_t);
 
 int stats_record(std::unique_ptr<stats>&, uint64_t);
 void stats_correct(std::unique_ptr<stats>&, int64_t);
 long double stats_mean(std::unique_ptr<stats>&);
 long double stats_stdev(std::unique_ptr<stats>&, long double);
-long double stats_within_stdev(std::unique_ptr<stats>&, long double, long double, uint64_t);
\ No newline at end of file
+long double stats_within_stdev(std::unique_ptr<stats>&, long double, long double, uint64_t);
+uint64_t stats_percentile(std::unique_ptr<stats>&, long double);
+void stats_merge(std::unique_ptr<stats>&, std::unique_ptr<stats>&);
+void stats_reset(std::unique_ptr<stats>&);
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "think.hpp"
+#include "units.hpp"
+
+#include <cmath>
+
+// 100ms or const:100ms, uniform:50ms,150ms, exp:100ms (mean), lognormal:100ms,0.5 (median, sigma)
+int scanThink(std::string s, thinkTime& think)
+{
+    size_t colon = s.find(':');
+    std::string kind = colon == std::string::npos ? "const" : s.substr(0, colon);
+    std::string arg = colon == std::string::npos ? s : s.substr(colon + 1);
+    std::string first = arg.substr(0, arg.find(','));
+    std::string second = arg.find(',') == std::string::npos ? "" : arg.substr(arg.find(',') + 1);
+
+    think.text = s;
+
+    if (first.empty() || !isdigit(static_cast<unsigned char>(first[0])) || scanTime_us(first, think.a_us))
+        return 1;
+
+    if (kind == "const" && second.empty())
+    {
+        think.kind = ThinkKind::CONSTANT;
+    }
+    else if (kind == "uniform")
+    {
+        think.kind = ThinkKind::UNIFORM;
+        if (second.empty() || !isdigit(static_cast<unsigned char>(second[0])) || scanTime_us(second, think.b_us) || think.b_us < think.a_us)
+            return 1;
+    }
+    else if (kind == "exp" && second.empty())
+    {
+        think.kind = ThinkKind::EXPONENTIAL;
+    }
+    else if (kind == "lognormal")
+    {
+        char* end = nullptr;
+        think.kind = ThinkKind::LOGNORMAL;
+        think.sigma = strtold(second.c_str(), &end);
+        if (second.empty() || *end || !(think.sigma > 0) || !think.a_us)
+            return 1;
+    }
+    else
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+long double thinkMean_us(const thinkTime& think)
+{
+    switch (think.kind)
+    {
+    case ThinkKind::UNIFORM:
+        return (think.a_us + think.b_us) / 2.0L;
+    case ThinkKind::LOGNORMAL:
+        return think.a_us * std::exp(think.sigma * think.sigma / 2);
+    case ThinkKind::NONE:
+        return 0;
+    default:
+        return think.a_us;
+    }
+}
+
+uint64_t thinkDraw(const thinkTime& think, std::mt19937_64& random)
+{
+    long double us = 0;
+
+    switch (think.kind)
+    {
+    case ThinkKind::NONE:
+        return 0;
+    case ThinkKind::CONSTANT:
+        return think.a_us;
+    case ThinkKind::UNIFORM:
+        return std::uniform_int_distribution<uint64_t>(think.a_us, think.b_us)(random);
+    case ThinkKind::EXPONENTIAL:
+        us = think.a_us ? std::exponential_distribution<double>(1.0 / think.a_us)(random) : 0;
+        break;
+    case ThinkKind::LOGNORMAL:
+        // The median is e^mu
+        us = std::lognormal_distribution<double>(std::log(static_cast<double>(think.a_us)), static_cast<double>(think.sigma))(random);
+        break;
+    }
+
+    return static_cast<uint64_t>(std::min<long double>(us, THINK_MAX_US));
+}
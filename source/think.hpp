@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <random>
+
+// Longest pause drawn, the tails of exponential and lognormal are cut here
+#define THINK_MAX_US    (3600ULL * 1000000)
+
+enum class ThinkKind
+{
+    NONE,
+    CONSTANT,
+    UNIFORM,
+    EXPONENTIAL,
+    LOGNORMAL
+};
+
+// --think: the pause of a virtual user between an answer and its next request
+struct thinkTime
+{
+    ThinkKind kind = ThinkKind::NONE;
+    uint64_t a_us = 0;          // the constant, the low bound, the mean or the median
+    uint64_t b_us = 0;          // the high bound of uniform
+    long double sigma = 0;      // lognormal spread
+    std::string text;
+};
+
+int scanThink(std::string, thinkTime&);
+long double thinkMean_us(const thinkTime&);
+uint64_t thinkDraw(const thinkTime&, std::mt19937_64&);
@@ -0,0 +1,186 @@
+#include "timeline.hpp"
+#include "units.hpp"
+
+#define HEATMAP_SHADES  " .:-=+*#%@"
+
+// limit_us bounds the latency histograms, path may be empty when only the heatmap is wanted
+bool timelineInit(timeline& t, const std::string& path, uint64_t interval_ms, uint64_t limit_us)
+{
+    t.interval_ms = interval_ms;
+    statsInit(t.current, limit_us);
+    timingInit(t.timing, limit_us);
+
+    if (path.empty())
+        return true;
+
+    t.log = fopen(path.c_str(), "w");
+    if (!t.log)
+        return false;
+
+    fprintf(t.log, "#mrk interval log v2: latency in us, not corrected for coordinated omission\n");
+    fprintf(t.log, "#buckets are log-linear (%d sub-bucket bits), listed as index delta:count\n", STATS_SUB_BITS);
+    fprintf(t.log, "#start_s,interval_s,count,min,p50,p90,p99,p99.9,max,connect_p50,connect_p99,send_p50,send_p99,"
+        "wait_p50,wait_p99,transfer_p50,transfer_p99,buckets\n");
+
+    return true;
+}
+
+// Band of the heatmap holding a latency
+int heatmapRow(uint64_t us)
+{
+    int row = 0;
+    while (us > 1 && row < HEATMAP_ROWS - 1)
+    {
+        us >>= 1;
+        row++;
+    }
+
+    return row;
+}
+
+void heatmapAdd(timeline& t)
+{
+    uint64_t column = t.intervals / t.span;
+
+    if (column >= HEATMAP_COLUMNS)
+    {
+        // Out of columns: halve the resolution of everything so far
+        for (size_t i = 0; i < t.columns.size(); ++i)
+        {
+            std::array<uint64_t, HEATMAP_ROWS>& merged = t.columns[i / 2];
+            const std::array<uint64_t, HEATMAP_ROWS> from = t.columns[i];
+
+            if (i % 2 == 0)
+                merged = from;
+            else
+                for (int row = 0; row < HEATMAP_ROWS; ++row)
+                    merged[row] += from[row];
+        }
+
+        t.columns.resize((t.columns.size() + 1) / 2);
+        t.span *= 2;
+        column = t.intervals / t.span;
+    }
+
+    if (column >= t.columns.size())
+        t.columns.resize(column + 1, {});
+
+    std::unique_ptr<stats>& current = t.current;
+    if (!current->count)
+        return;
+
+    for (size_t i = stats_bucket(current->min); i <= stats_bucket(current->max); ++i)
+    {
+        if (current->data[i])
+            t.columns[column][heatmapRow(stats_value(i))] += current->data[i];
+    }
+}
+
+// Closes the current interval: one log line, one heatmap slice, then starts over
+void timelineAdd(timeline& t)
+{
+    std::unique_ptr<stats>& current = t.current;
+
+    if (t.log)
+    {
+        fprintf(t.log, "%.3f,%.3f,%llu,%llu", t.intervals * t.interval_ms / 1000.0, t.interval_ms / 1000.0,
+            (unsigned long long)current->count, (unsigned long long)(current->count ? current->min : 0));
+
+        for (long double p : { 50.0L, 90.0L, 99.0L, 99.9L })
+            fprintf(t.log, ",%llu", (unsigned long long)stats_percentile(current, p));
+
+        fprintf(t.log, ",%llu", (unsigned long long)current->max);
+
+        for (auto& phase : t.timing.phase)
+        {
+            fprintf(t.log, ",%llu,%llu", (unsigned long long)stats_percentile(phase, 50.0L),
+                (unsigned long long)stats_percentile(phase, 99.0L));
+        }
+
+        fprintf(t.log, ",");
+
+        if (current->count)
+        {
+            size_t last = 0;
+            const char* separator = "";
+
+            for (size_t i = stats_bucket(current->min); i <= stats_bucket(current->max); ++i)
+            {
+                if (!current->data[i])
+                    continue;
+
+                fprintf(t.log, "%s%zu:%llu", separator, i - last, (unsigned long long)current->data[i]);
+                last = i;
+                separator = " ";
+            }
+        }
+
+        fprintf(t.log, "\n");
+        fflush(t.log);
+    }
+
+    heatmapAdd(t);
+
+    t.intervals++;
+    stats_reset(current);
+    timingReset(t.timing);
+}
+
+void timelineClose(timeline& t)
+{
+    if (t.log)
+        fclose(t.log);
+
+    t.log = nullptr;
+}
+
+// Rows are latency bands, columns time; shading is each column's share of its responses
+void timelinePrint(timeline& t)
+{
+    int low = HEATMAP_ROWS, high = -1;
+
+    for (const auto& column : t.columns)
+    {
+        for (int row = 0; row < HEATMAP_ROWS; ++row)
+        {
+            if (column[row])
+            {
+                low = std::min(low, row);
+                high = std::max(high, row);
+            }
+        }
+    }
+
+    if (high < 0)
+        return;
+
+    std::string width = formatTime_us(t.span * t.interval_ms * 1000.0L, 0);
+    printf("  Latency heatmap, %s per column, shade is the share of the column's responses\n", width.c_str());
+
+    const char* shades = HEATMAP_SHADES;
+    int levels = static_cast<int>(strlen(shades)) - 1;
+
+    for (int row = high; row >= low; --row)
+    {
+        printf("  %10s |", formatTime_us(static_cast<long double>(1ULL << row), 0).c_str());
+
+        for (const auto& column : t.columns)
+        {
+            uint64_t total = 0;
+            for (uint64_t n : column)
+                total += n;
+
+            int level = 0;
+            if (column[row])
+                level = 1 + static_cast<int>((levels - 1) * column[row] / static_cast<long double>(total));
+
+            putchar(shades[level]);
+        }
+
+        printf("\n");
+    }
+
+    std::string end = formatTime_us(t.intervals * t.interval_ms * 1000.0L, 0);
+    printf("  %10s +%s\n", "", std::string(t.columns.size(), '-').c_str());
+    printf("  %10s  0s%*s\n", "", static_cast<int>(std::max<size_t>(t.columns.size(), 2) - 2 + end.size()), end.c_str());
+}
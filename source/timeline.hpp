@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+
+#include "stats.hpp"
+
+// Latency over time: one histogram per interval, streamed to the interval log as soon as
+// it is complete, and folded into a fixed size heatmap grid. Memory stays bounded on soaks.
+#define HEATMAP_ROWS     40     // power of two latency bands, 1us to ~6 days
+#define HEATMAP_COLUMNS  60     // neighbouring columns are merged when the run outgrows them
+
+struct timeline
+{
+    FILE* log = nullptr;
+    uint64_t interval_ms = 1000;
+    uint64_t intervals = 0;
+    std::unique_ptr<stats> current = std::make_unique<stats>();
+    timingStats timing;         // phases of the current interval, for the log
+    std::vector<std::array<uint64_t, HEATMAP_ROWS>> columns;
+    uint64_t span = 1;          // intervals per heatmap column
+};
+
+bool timelineInit(timeline&, const std::string&, uint64_t, uint64_t);
+void timelineAdd(timeline&);
+void timelineClose(timeline&);
+void timelinePrint(timeline&);
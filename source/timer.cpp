@@ -0,0 +1,193 @@
+#include "timer.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+void timerInit(timerWheel& wheel, uint64_t now)
+{
+    wheel = {};
+    wheel.now = now;
+}
+
+void timerLink(timerWheel& wheel, timerNode& node)
+{
+    uint64_t delta = node.expires - wheel.now;
+    int level = 0;
+
+    while (level < TIMER_LEVELS - 1 && delta >= (1ULL << ((level + 1) * TIMER_SLOT_BITS)))
+        level++;
+
+    uint32_t index = (node.expires >> (level * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK;
+    timerNode*& head = wheel.slots[level][index];
+
+    node.slot = level * TIMER_SLOTS + index;
+    node.next = head;
+    node.pprev = &head;
+    if (head)
+        head->pprev = &node.next;
+    head = &node;
+
+    wheel.occupied[level] |= 1ULL << index;
+}
+
+void timerUnlink(timerWheel& wheel, timerNode& node)
+{
+    *node.pprev = node.next;
+    if (node.next)
+        node.next->pprev = node.pprev;
+
+    uint32_t level = node.slot / TIMER_SLOTS;
+    uint32_t index = node.slot % TIMER_SLOTS;
+    if (!wheel.slots[level][index])
+        wheel.occupied[level] &= ~(1ULL << index);
+
+    node.next = nullptr;
+    node.pprev = nullptr;
+}
+
+void timerArm(timerWheel& wheel, timerNode& node, uint64_t expires)
+{
+    if (node.pprev)
+        timerUnlink(wheel, node);
+    else
+        wheel.count++;
+
+    uint64_t max = wheel.now + (1ULL << (TIMER_LEVELS * TIMER_SLOT_BITS)) - 1;
+
+    if (expires < wheel.now)
+        expires = wheel.now;
+    else if (expires > max)
+        expires = max;
+
+    node.expires = expires;
+    timerLink(wheel, node);
+}
+
+void timerCancel(timerWheel& wheel, timerNode& node)
+{
+    if (!node.pprev)
+        return;
+
+    timerUnlink(wheel, node);
+    wheel.count--;
+}
+
+bool timerArmed(const timerNode& node)
+{
+    return node.pprev != nullptr;
+}
+
+void timerCascade(timerWheel& wheel, int level)
+{
+    uint32_t index = (wheel.now >> (level * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK;
+    timerNode* node = wheel.slots[level][index];
+
+    wheel.slots[level][index] = nullptr;
+    wheel.occupied[level] &= ~(1ULL << index);
+
+    while (node)
+    {
+        timerNode* next = node->next;
+        timerLink(wheel, *node);
+        node = next;
+    }
+}
+
+// Moves every timer with a deadline <= now into expired
+void timerAdvance(timerWheel& wheel, uint64_t now, std::vector<timerNode*>& expired)
+{
+    while (wheel.now <= now)
+    {
+        if (!wheel.count)
+        {
+            wheel.now = now + 1;
+            break;
+        }
+
+        if ((wheel.now & TIMER_SLOT_MASK) == 0)
+        {
+            for (int level = 1; level < TIMER_LEVELS; ++level)
+            {
+                timerCascade(wheel, level);
+
+                if ((wheel.now >> (level * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK)
+                    break;
+            }
+        }
+
+        if (!wheel.occupied[0])
+        {
+            // Nothing due until the next cascade boundary
+            uint64_t next = (wheel.now | TIMER_SLOT_MASK) + 1;
+            wheel.now = next < now + 1 ? next : now + 1;
+            continue;
+        }
+
+        uint32_t index = wheel.now & TIMER_SLOT_MASK;
+        timerNode* node = wheel.slots[0][index];
+
+        wheel.slots[0][index] = nullptr;
+        wheel.occupied[0] &= ~(1ULL << index);
+
+        while (node)
+        {
+            timerNode* next = node->next;
+
+            node->next = nullptr;
+            node->pprev = nullptr;
+            wheel.count--;
+
+            expired.push_back(node);
+            node = next;
+        }
+
+        wheel.now++;
+    }
+}
+
+// Distance in slots to the first occupied one, starting from index included
+uint64_t timerDistance(uint64_t occupied, uint32_t index)
+{
+    uint64_t rotated = (occupied >> index) | (index ? occupied << (TIMER_SLOTS - index) : 0);
+
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward64(&bit, rotated);
+    return bit;
+#else
+    return __builtin_ctzll(rotated);
+#endif
+}
+
+// Ticks until the next deadline is due (a lower bound for upper levels), TIMER_NONE if idle
+uint64_t timerNext(const timerWheel& wheel)
+{
+    if (!wheel.count)
+        return TIMER_NONE;
+
+    uint64_t next = TIMER_NONE;
+
+    if (wheel.occupied[0])
+        next = timerDistance(wheel.occupied[0], wheel.now & TIMER_SLOT_MASK);
+
+    for (int level = 1; level < TIMER_LEVELS && next; ++level)
+    {
+        if (!wheel.occupied[level])
+            continue;
+
+        uint64_t block = wheel.now >> (level * TIMER_SLOT_BITS);
+        uint32_t index = block & TIMER_SLOT_MASK;
+
+        // The current slot is still to be cascaded when sitting exactly on its boundary
+        uint64_t distance = (wheel.now & ((1ULL << (level * TIMER_SLOT_BITS)) - 1)) == 0
+            ? timerDistance(wheel.occupied[level], index)
+            : timerDistance(wheel.occupied[level], (index + 1) & TIMER_SLOT_MASK) + 1;
+        uint64_t ticks = ((block + distance) << (level * TIMER_SLOT_BITS)) - wheel.now;
+
+        if (ticks < next)
+            next = ticks;
+    }
+
+    return next;
+}
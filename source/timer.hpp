@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timer wheel, one per worker thread.
+// Each level has 64 slots, level N slot covers 64^N ticks (1 tick = 1 ms),
+// so 4 levels span ~4.6 hours; later deadlines are clamped to the last slot.
+#define TIMER_LEVELS     4
+#define TIMER_SLOT_BITS  6
+#define TIMER_SLOTS      (1 << TIMER_SLOT_BITS)
+#define TIMER_SLOT_MASK  (TIMER_SLOTS - 1)
+#define TIMER_NONE       UINT64_MAX
+
+// Intrusive node, embedded in the object owning the deadline
+struct timerNode
+{
+    timerNode* next = nullptr;
+    timerNode** pprev = nullptr;
+    uint64_t expires = 0;
+    uint32_t slot = 0;
+    void* data = nullptr;
+};
+
+struct timerWheel
+{
+    uint64_t now = 0;
+    uint64_t count = 0;
+    uint64_t occupied[TIMER_LEVELS] = {};
+    timerNode* slots[TIMER_LEVELS][TIMER_SLOTS] = {};
+};
+
+void timerInit(timerWheel&, uint64_t);
+void timerArm(timerWheel&, timerNode&, uint64_t);
+void timerCancel(timerWheel&, timerNode&);
+bool timerArmed(const timerNode&);
+void timerAdvance(timerWheel&, uint64_t, std::vector<timerNode*>&);
+uint64_t timerNext(const timerWheel&);
@@ -87,6 +87,11 @@ std::string formatBinary(long double n)
     return formatUnits(n, binary_units, 2);
 }
 
+std::string formatBytes(long double n, int p)
+{
+    return formatUnits(n, binary_units, p) + "B";
+}
+
 std::string formatMetric(long double n, int p) 
 {
     return formatUnits(n, metric_units, p);
@@ -118,3 +123,108 @@ int scanTime(std::string s, uint64_t& n)
 {
     return scanUnits(s, n, time_units_s);
 }
+
+int scanTime_ms(std::string s, uint64_t& n)
+{
+    if (s.size() > 2 && s.compare(s.size() - 2, 2, "ms") == 0)
+        return scanUnits(s.substr(0, s.size() - 2), n, metric_units);
+
+    if (scanTime(s, n))
+        return 1;
+
+    n *= 1000;
+    return 0;
+}
+
+// 500us, 20ms, 1s
+int scanTime_us(std::string s, uint64_t& n)
+{
+    if (s.size() > 2 && s.compare(s.size() - 2, 2, "us") == 0)
+        return scanUnits(s.substr(0, s.size() - 2), n, metric_units);
+
+    return scanUnits(s, n, time_units_us);
+}
+
+// Comma separated numbers and ranges, e.g. 0,2-5
+int scanList(std::string s, std::vector<int>& list)
+{
+    std::stringstream items(s);
+    std::string item;
+
+    while (std::getline(items, item, ','))
+    {
+        size_t dash = item.find('-');
+        char* end = nullptr;
+
+        long first = strtol(item.c_str(), &end, 10);
+        long last = dash == std::string::npos ? first : strtol(item.c_str() + dash + 1, &end, 10);
+
+        if (item.empty() || *end || first < 0 || last < first)
+            return 1;
+
+        for (long i = first; i <= last; ++i)
+            list.push_back(static_cast<int>(i));
+    }
+
+    return 0;
+}
+
+// Comma separated numbers, each may have a SI unit: "3,1"
+int scanMetrics(std::string s, std::vector<uint64_t>& list)
+{
+    std::stringstream items(s);
+    std::string item;
+
+    while (std::getline(items, item, ','))
+    {
+        uint64_t value = 0;
+        if (item.empty() || scanMetric(item, value))
+            return 1;
+
+        list.push_back(value);
+    }
+
+    return 0;
+}
+
+// HTTP status list, scanList syntax plus classes: "200,204,3xx"
+int scanStatus(std::string s, std::vector<int>& list)
+{
+    std::stringstream items(s);
+    std::string item;
+
+    while (std::getline(items, item, ','))
+    {
+        if (item.size() == 3 && isdigit(item[0]) && tolower(item[1]) == 'x' && tolower(item[2]) == 'x')
+        {
+            for (int i = 0; i < 100; ++i)
+                list.push_back((item[0] - '0') * 100 + i);
+        }
+        else if (scanList(item, list))
+        {
+            return 1;
+        }
+    }
+
+    return list.empty() || *std::max_element(list.begin(), list.end()) > 999;
+}
+
+// Bytes written as hex digits, "2a0d0a" or "2A 0D 0A"
+int scanHex(std::string s, std::string& bytes)
+{
+    bytes.clear();
+    s.erase(std::remove(s.begin(), s.end(), ' '), s.end());
+
+    if (s.empty() || s.size() % 2)
+        return -1;
+
+    for (size_t i = 0; i < s.size(); i += 2)
+    {
+        if (!isxdigit(static_cast<unsigned char>(s[i])) || !isxdigit(static_cast<unsigned char>(s[i + 1])))
+            return -1;
+
+        bytes += static_cast<char>(std::stoi(s.substr(i, 2), nullptr, 16));
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -19,9 +19,16 @@ struct units
 };
 
 std::string formatBinary(long double);
+std::string formatBytes(long double, int = 2);
 std::string formatMetric(long double, int = 2);
 std::string formatTime_us(long double, int = 2);
 std::string formatTime_s(long double);
 
 int scanMetric(std::string, uint64_t&);
 int scanTime(std::string, uint64_t&);
+int scanTime_ms(std::string, uint64_t&);
+int scanTime_us(std::string, uint64_t&);
+int scanList(std::string, std::vector<int>&);
+int scanMetrics(std::string, std::vector<uint64_t>&);
+int scanStatus(std::string, std::vector<int>&);
+int scanHex(std::string, std::string&);
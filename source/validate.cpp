@@ -0,0 +1,262 @@
+#include "validate.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#define XXH_PRIME1  11400714785074694791ULL
+#define XXH_PRIME2  14029467366897019727ULL
+#define XXH_PRIME3  1609587929392839161ULL
+#define XXH_PRIME4  9650029242287828579ULL
+#define XXH_PRIME5  2870177450012600261ULL
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t read32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t xxhRound(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME1;
+}
+
+inline uint64_t xxhMerge(uint64_t acc, uint64_t v)
+{
+    acc ^= xxhRound(0, v);
+    return acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+// Consumes whole 32 byte stripes, returns where it stopped
+const unsigned char* xxhStripes(uint64_t* v, const unsigned char* p, const unsigned char* end)
+{
+    uint64_t v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+
+    for (; p + 32 <= end; p += 32)
+    {
+        v1 = xxhRound(v1, read64(p));
+        v2 = xxhRound(v2, read64(p + 8));
+        v3 = xxhRound(v3, read64(p + 16));
+        v4 = xxhRound(v4, read64(p + 24));
+    }
+
+    v[0] = v1; v[1] = v2; v[2] = v3; v[3] = v4;
+
+    return p;
+}
+
+void xxh64Reset(xxh64State& s)
+{
+    s.total = 0;
+    s.v[0] = XXH_PRIME1 + XXH_PRIME2;
+    s.v[1] = XXH_PRIME2;
+    s.v[2] = 0;
+    s.v[3] = 0 - XXH_PRIME1;
+    s.buffered = 0;
+}
+
+void xxh64Update(xxh64State& s, const char* data, size_t size)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+
+    s.total += size;
+
+    if (s.buffered + size < 32)
+    {
+        memcpy(s.buffer + s.buffered, p, size);
+        s.buffered += size;
+        return;
+    }
+
+    if (s.buffered)
+    {
+        size_t fill = 32 - s.buffered;
+        memcpy(s.buffer + s.buffered, p, fill);
+        xxhStripes(s.v, s.buffer, s.buffer + 32);
+
+        p += fill;
+        s.buffered = 0;
+    }
+
+    p = xxhStripes(s.v, p, end);
+
+    s.buffered = end - p;
+    memcpy(s.buffer, p, s.buffered);
+}
+
+uint64_t xxh64Digest(const xxh64State& s)
+{
+    uint64_t h;
+
+    if (s.total >= 32)
+    {
+        h = rotl64(s.v[0], 1) + rotl64(s.v[1], 7) + rotl64(s.v[2], 12) + rotl64(s.v[3], 18);
+        for (int i = 0; i < 4; ++i)
+            h = xxhMerge(h, s.v[i]);
+    }
+    else
+    {
+        h = XXH_PRIME5;
+    }
+
+    h += s.total;
+
+    const unsigned char* p = s.buffer;
+    const unsigned char* end = p + s.buffered;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= xxhRound(0, read64(p));
+        h = rotl64(h, 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+
+    if (p + 4 <= end)
+    {
+        h ^= read32(p) * XXH_PRIME1;
+        h = rotl64(h, 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+    }
+
+    for (; p < end; ++p)
+    {
+        h ^= *p * XXH_PRIME5;
+        h = rotl64(h, 11) * XXH_PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+uint64_t xxh64(const char* data, size_t size)
+{
+    xxh64State s;
+    xxh64Reset(s);
+    xxh64Update(s, data, size);
+
+    return xxh64Digest(s);
+}
+
+// First occurrence of needle, candidates come from the libc (vectorized) memchr on its first byte
+const char* findSubstring(const char* data, size_t size, const std::string& needle)
+{
+    size_t n = needle.size();
+    if (!n || size < n)
+        return nullptr;
+
+    const char* p = data;
+    const char* last = data + size - n;
+    char first = needle[0];
+
+    while (p <= last)
+    {
+        p = static_cast<const char*>(memchr(p, first, last - p + 1));
+        if (!p)
+            return nullptr;
+
+        if (memcmp(p + 1, needle.data() + 1, n - 1) == 0)
+            return p;
+
+        p++;
+    }
+
+    return nullptr;
+}
+
+// Rules that need to see the body bytes, not just the framing
+bool validateBody(const validation& v)
+{
+    return v.hash || !v.substring.empty();
+}
+
+void validateReset(validationState& state)
+{
+    xxh64Reset(state.hash);
+    state.carry.clear();
+    state.found = false;
+}
+
+// Body span handler of responseParse, ctx is the connection's validationState
+void validateSpan(void* ctx, const char* data, size_t size)
+{
+    validationState& state = *static_cast<validationState*>(ctx);
+    const validation& rules = *state.rules;
+
+    if (rules.hash)
+        xxh64Update(state.hash, data, size);
+
+    if (rules.substring.empty() || state.found)
+        return;
+
+    size_t keep = rules.substring.size() - 1;
+
+    if (!state.carry.empty())
+    {
+        // Matches across the previous read and this one
+        size_t head = std::min(size, keep);
+        size_t tail = state.carry.size();
+
+        state.carry.append(data, head);
+        state.found = findSubstring(state.carry.data(), state.carry.size(), rules.substring) != nullptr;
+        state.carry.resize(tail);
+    }
+
+    if (!state.found)
+        state.found = findSubstring(data, size, rules.substring) != nullptr;
+
+    if (state.found || !keep)
+        return;
+
+    if (size >= keep)
+    {
+        state.carry.assign(data + size - keep, keep);
+    }
+    else
+    {
+        state.carry.append(data, size);
+        if (state.carry.size() > keep)
+            state.carry.erase(0, state.carry.size() - keep);
+    }
+}
+
+// Checks a complete response, returns the VALIDATE_* rules it failed
+int validateEnd(validationState& state, const httpResponse& response)
+{
+    const validation& rules = *state.rules;
+    int failed = 0;
+
+    if (rules.status && (response.status < 0 || response.status >= HTTP_STATUS_MAX || !rules.statuses[response.status]))
+        failed |= VALIDATE_STATUS;
+
+    if (rules.length && response.body != rules.size)
+        failed |= VALIDATE_LENGTH;
+
+    if (!rules.substring.empty() && !state.found)
+        failed |= VALIDATE_SUBSTRING;
+
+    if (rules.hash && xxh64Digest(state.hash) != rules.reference)
+        failed |= VALIDATE_HASH;
+
+    validateReset(state);
+
+    return failed;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <bitset>
+
+#include "parser.hpp"
+
+// Failed rules of one response
+#define VALIDATE_STATUS     1
+#define VALIDATE_LENGTH     2
+#define VALIDATE_SUBSTRING  4
+#define VALIDATE_HASH       8
+
+// Response checks from the --expect-* options, all applied while the body streams in
+struct validation
+{
+    bool status = false;
+    std::bitset<HTTP_STATUS_MAX> statuses;
+    bool length = false;
+    uint64_t size = 0;
+    std::string substring;
+    bool hash = false;
+    uint64_t reference = 0;     // xxHash64 of the expected body
+    std::string hashFile;
+};
+
+// Mismatches per rule, a response failing several counts once in errorsData.validation
+struct validationErrors
+{
+    uint32_t status;
+    uint32_t length;
+    uint32_t substring;
+    uint32_t hash;
+};
+
+// Streaming xxHash64, seed 0
+struct xxh64State
+{
+    uint64_t total;
+    uint64_t v[4];
+    unsigned char buffer[32];
+    size_t buffered;
+};
+
+void xxh64Reset(xxh64State&);
+void xxh64Update(xxh64State&, const char*, size_t);
+uint64_t xxh64Digest(const xxh64State&);
+uint64_t xxh64(const char*, size_t);
+
+const char* findSubstring(const char*, size_t, const std::string&);
+
+// Per connection progress of the body rules
+struct validationState
+{
+    const validation* rules = nullptr;
+    xxh64State hash;
+    std::string carry;          // tail of the body seen so far, a match may straddle two reads
+    bool found = false;
+};
+
+bool validateBody(const validation&);
+void validateReset(validationState&);
+void validateSpan(void*, const char*, size_t);
+int validateEnd(validationState&, const httpResponse&);
@@ -0,0 +1,132 @@
+#include "websocket.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// Upgrade request. The key is fixed, the server's accept value is not verified: a 101 is enough
+std::string wsHandshake(const std::string& host, const std::string& uri)
+{
+    std::string request;
+
+    request += "GET " + uri + " HTTP/1.1\r\n";
+    request += "Host: " + host + "\r\n";
+    request += "Upgrade: websocket\r\n";
+    request += "Connection: Upgrade\r\n";
+    request += "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n";
+    request += "Sec-WebSocket-Version: 13\r\n";
+
+    return request + "\r\n";
+}
+
+// Complete client frame, masked with mask: built once and resent as is
+std::string wsFrame(int opcode, const char* data, size_t size, const unsigned char* mask)
+{
+    std::string frame;
+
+    frame += static_cast<char>(0x80 | opcode);
+
+    if (size < 126)
+    {
+        frame += static_cast<char>(0x80 | size);
+    }
+    else if (size <= 0xFFFF)
+    {
+        frame += static_cast<char>(0x80 | 126);
+        frame += static_cast<char>(size >> 8);
+        frame += static_cast<char>(size & 0xFF);
+    }
+    else
+    {
+        frame += static_cast<char>(0x80 | 127);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            frame += static_cast<char>((static_cast<uint64_t>(size) >> shift) & 0xFF);
+    }
+
+    frame.append(reinterpret_cast<const char*>(mask), 4);
+
+    for (size_t i = 0; i < size; ++i)
+        frame += static_cast<char>(data[i] ^ mask[i & 3]);
+
+    return frame;
+}
+
+void wsReset(wsParser& p)
+{
+    p.have = 0;
+    p.need = 2;
+    p.payload = false;
+    p.remaining = 0;
+}
+
+// End of one frame: completes a message when it is the final data frame
+void wsFrameEnd(wsParser& p, uint64_t& messages, bool& closed)
+{
+    int opcode = p.header[0] & 0x0F;
+    bool fin = (p.header[0] & 0x80) != 0;
+
+    if (opcode == WS_OP_CLOSE)
+        closed = true;
+    else if (fin && opcode <= WS_OP_BINARY)
+        messages++;
+
+    wsReset(p);
+}
+
+// Consumes frames, adds the messages completed to messages; pings and pongs are skipped
+size_t wsParse(wsParser& p, const char* data, size_t size, uint64_t& messages, bool& closed)
+{
+    size_t i = 0;
+
+    while (i < size && !closed)
+    {
+        if (p.payload)
+        {
+            uint64_t n = std::min<uint64_t>(p.remaining, size - i);
+
+            p.remaining -= n;
+            i += n;
+
+            if (!p.remaining)
+                wsFrameEnd(p, messages, closed);
+
+            continue;
+        }
+
+        size_t n = std::min(p.need - p.have, size - i);
+        memcpy(p.header + p.have, data + i, n);
+        p.have += n;
+        i += n;
+
+        if (p.have < p.need)
+            break;
+
+        unsigned char length = p.header[1] & 0x7F;
+        bool masked = (p.header[1] & 0x80) != 0;
+        size_t need = 2 + (length == 126 ? 2 : length == 127 ? 8 : 0) + (masked ? 4 : 0);
+
+        if (p.need < need)
+        {
+            // Extended length or mask still to come
+            p.need = need;
+            continue;
+        }
+
+        if (length == 126)
+            p.remaining = (static_cast<uint64_t>(p.header[2]) << 8) | p.header[3];
+        else if (length == 127)
+        {
+            p.remaining = 0;
+            for (int b = 2; b < 10; ++b)
+                p.remaining = (p.remaining << 8) | p.header[b];
+        }
+        else
+            p.remaining = length;
+
+        p.payload = true;
+
+        if (!p.remaining)
+            wsFrameEnd(p, messages, closed);
+    }
+
+    return i;
+}
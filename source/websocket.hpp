@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#define WS_OP_CONTINUATION  0x0
+#define WS_OP_TEXT          0x1
+#define WS_OP_BINARY        0x2
+#define WS_OP_CLOSE         0x8
+
+#define WS_HEADER_MAX       14
+
+// Incremental frame parser for the server side of a ws:// connection, no allocation
+struct wsParser
+{
+    unsigned char header[WS_HEADER_MAX];
+    size_t have = 0;
+    size_t need = 2;
+    bool payload = false;
+    uint64_t remaining = 0;
+};
+
+std::string wsHandshake(const std::string&, const std::string&);
+std::string wsFrame(int, const char*, size_t, const unsigned char*);
+
+void wsReset(wsParser&);
+size_t wsParse(wsParser&, const char*, size_t, uint64_t&, bool&);